@@ -45,7 +45,7 @@ static void indent(int n) {
 static void print_ast_formatted(void *tree, int n, int nl) {
   NodeType ntype;
   char *name;
-  void *list_hd, *list_tl;
+  int nstmts, nexprs;
   int i, nargs;
 
   int indent_amt = n * SPACES_PER_INDENTATION_LEVEL;
@@ -89,10 +89,9 @@ static void print_ast_formatted(void *tree, int n, int nl) {
   case STMT_LIST:
     indent(indent_amt);
     printf("{\n");
-    while (tree != NULL) {
-      list_hd = stmt_list_head(tree);
-      tree = stmt_list_rest(tree);
-      print_ast_formatted(list_hd, n + 1, nl);
+    nstmts = stmt_list_length(tree);
+    for (i = 1; i <= nstmts; i++) {
+      print_ast_formatted(stmt_list_nth(tree, i), n + 1, nl);
     }
     indent(indent_amt);
     printf("}\n");
@@ -138,12 +137,13 @@ static void print_ast_formatted(void *tree, int n, int nl) {
     break;
 
   case EXPR_LIST:
-    list_tl = expr_list_rest(tree);
-    print_ast_formatted(expr_list_head(tree), 0, 0);
-    if (list_tl != NULL) {
-      printf(", ");
+    nexprs = expr_list_length(tree);
+    for (i = 1; i <= nexprs; i++) {
+      print_ast_formatted(expr_list_nth(tree, i), 0, 0);
+      if (i < nexprs) {
+        printf(", ");
+      }
     }
-    print_ast_formatted(list_tl, 0, 0);
     break;
 
   case IDENTIFIER:
@@ -154,6 +154,12 @@ static void print_ast_formatted(void *tree, int n, int nl) {
     printf("%d", expr_intconst_val(tree));
     break;
 
+  case NOT:
+    printf("!(");
+    print_ast_formatted(expr_operand_1(tree), 0, 0);
+    printf(")");
+    break;
+
   case UMINUS:
     printf("-(");
     print_ast_formatted(expr_operand_1(tree), 0, 0);
@@ -228,6 +234,8 @@ char *opname(NodeType ntype) {
     return "&&";
   case OR:
     return "||";
+  case NOT:
+    return "!";
 
   default:
     fprintf(stderr, "*** [%s] Unrecognized syntax tree node type %d\n",
@@ -1,52 +1,339 @@
 #include "ast.h"
+#include "ast_store.h"
 #include "symbol_table.h"
 #include <assert.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
-ASTnode *create_ast_node() {
-  ASTnode *new_ast_node = malloc(sizeof(ASTnode));
-  if (!new_ast_node) {
+/*******************************************************************************
+ *                                                                             *
+ *                               AST NODE ARENAS                               *
+ *                                                                             *
+ *******************************************************************************/
+
+// Size of a regular chunk; larger requests get a chunk of their own
+#define AST_ARENA_CHUNK_SIZE (64 * 1024)
+#define AST_ARENA_ALIGN 16
+
+typedef struct ASTArenaChunk {
+  struct ASTArenaChunk *next;
+  size_t size;
+  size_t used;
+  _Alignas(AST_ARENA_ALIGN) unsigned char data[];
+} ASTArenaChunk;
+
+struct ASTArena {
+  ASTArenaChunk *chunks; // most recent chunk first; allocation happens there
+  size_t bytes_used;
+  size_t bytes_reserved;
+  size_t node_count[AST_NODE_TYPE_COUNT];
+
+  // Hash-consing table: open addressing, capacity a power of two
+  bool hash_consing;
+  ASTnode **cons_table;
+  size_t cons_capacity;
+  size_t cons_count;
+  size_t cons_hits;
+};
+
+static ASTArena *current_arena = NULL;
+static ASTArena *default_arena = NULL;
+
+static ASTArenaChunk *new_arena_chunk(size_t size) {
+  ASTArenaChunk *chunk = malloc(sizeof(ASTArenaChunk) + size);
+  if (!chunk) {
     fprintf(stderr, "ERROR: Memory allocation failed\n");
     exit(1);
   }
 
-  new_ast_node->node_type = DUMMY;
-  new_ast_node->symbol = NULL;
-  new_ast_node->num = 0;
-  new_ast_node->child0 = NULL;
-  new_ast_node->child1 = NULL;
-  new_ast_node->child2 = NULL;
+  chunk->next = NULL;
+  chunk->size = size;
+  chunk->used = 0;
+
+  return chunk;
+}
+
+ASTArena *ast_arena_create(void) {
+  ASTArena *arena = calloc(1, sizeof(ASTArena));
+  if (!arena) {
+    fprintf(stderr, "ERROR: Memory allocation failed\n");
+    exit(1);
+  }
+
+  return arena;
+}
+
+void ast_arena_destroy(ASTArena *arena) {
+  if (!arena) {
+    return;
+  }
+
+  ASTArenaChunk *chunk = arena->chunks;
+  while (chunk) {
+    ASTArenaChunk *next = chunk->next;
+    free(chunk);
+    chunk = next;
+  }
+
+  free(arena->cons_table);
+  free(arena);
+}
+
+void ast_arena_set_hash_consing(ASTArena *arena, bool enabled) {
+  arena->hash_consing = enabled;
+}
+
+ASTArena *ast_arena_use(ASTArena *arena) {
+  ASTArena *previous = current_arena;
+  current_arena = arena;
+  return previous;
+}
+
+void *ast_arena_alloc(ASTArena *arena, size_t size) {
+  size = (size + AST_ARENA_ALIGN - 1) & ~(size_t)(AST_ARENA_ALIGN - 1);
+
+  ASTArenaChunk *chunk = arena->chunks;
+  if (!chunk || chunk->size - chunk->used < size) {
+    if (size > AST_ARENA_CHUNK_SIZE / 4) {
+      // Oversized requests get a dedicated chunk behind the current one, so
+      // the free space left in the current chunk is not thrown away
+      chunk = new_arena_chunk(size);
+      if (arena->chunks) {
+        chunk->next = arena->chunks->next;
+        arena->chunks->next = chunk;
+      } else {
+        arena->chunks = chunk;
+      }
+    } else {
+      chunk = new_arena_chunk(AST_ARENA_CHUNK_SIZE);
+      chunk->next = arena->chunks;
+      arena->chunks = chunk;
+    }
+    arena->bytes_reserved += chunk->size;
+  }
+
+  void *memory = chunk->data + chunk->used;
+  chunk->used += size;
+  arena->bytes_used += size;
+
+  memset(memory, 0, size);
+  return memory;
+}
+
+size_t ast_arena_node_count(const ASTArena *arena, NodeType node_type) {
+  return arena->node_count[node_type];
+}
+
+size_t ast_arena_node_bytes(const ASTArena *arena, NodeType node_type) {
+  return arena->node_count[node_type] * sizeof(ASTnode);
+}
+
+size_t ast_arena_bytes_used(const ASTArena *arena) { return arena->bytes_used; }
+
+size_t ast_arena_bytes_reserved(const ASTArena *arena) {
+  return arena->bytes_reserved;
+}
+
+size_t ast_arena_shared_count(const ASTArena *arena) {
+  return arena->cons_hits;
+}
+
+void ast_arena_print_stats(const ASTArena *arena, FILE *out) {
+  size_t total_nodes = 0;
+  for (int type = 0; type < AST_NODE_TYPE_COUNT; type++) {
+    if (arena->node_count[type] == 0) {
+      continue;
+    }
+    total_nodes += arena->node_count[type];
+    fprintf(out, "%-12s %8zu nodes %10zu bytes\n", ast_node_type_name(type),
+            arena->node_count[type], ast_arena_node_bytes(arena, type));
+  }
+  fprintf(out, "%-12s %8zu nodes %10zu bytes used, %zu reserved\n", "total",
+          total_nodes, arena->bytes_used, arena->bytes_reserved);
+  if (arena->hash_consing) {
+    fprintf(out, "%-12s %8zu nodes reused\n", "shared", arena->cons_hits);
+  }
+}
+
+const char *ast_node_type_name(NodeType node_type) {
+  static const char *names[AST_NODE_TYPE_COUNT] = {
+      "ADD",       "AND", "ASSG",   "DIV",    "DUMMY",     "EQ",  "EXPR_LIST",
+      "FUNC_CALL", "FUNC_DEF",      "GE",     "GT",        "IDENTIFIER",
+      "IF",        "INTCONST",      "LE",     "LT",        "MUL", "NE",
+      "NOT",       "OR",  "RETURN", "STMT_LIST",           "SUB", "UMINUS",
+      "WHILE",
+  };
+  return names[node_type];
+}
+
+static ASTArena *active_arena(void) {
+  if (current_arena) {
+    return current_arena;
+  }
+  if (!default_arena) {
+    default_arena = ast_arena_create();
+  }
+  return default_arena;
+}
+
+static ASTnode *create_ast_node(NodeType node_type) {
+  ASTArena *arena = active_arena();
+
+  ASTnode *new_ast_node = ast_arena_alloc(arena, sizeof(ASTnode));
+  arena->node_count[node_type]++;
+
+  new_ast_node->node_type = node_type;
 
   return new_ast_node;
 }
 
-ASTnode *create_one_child_node(NodeType node_type, ASTnode *child0) {
-  ASTnode *node = create_ast_node();
+// Kinds whose nodes only compute a value from their children
+static bool is_pure_kind(NodeType node_type) {
+  switch (node_type) {
+  case ADD:
+  case SUB:
+  case MUL:
+  case DIV:
+  case UMINUS:
+  case EQ:
+  case NE:
+  case LT:
+  case LE:
+  case GT:
+  case GE:
+  case AND:
+  case OR:
+  case NOT:
+  case IDENTIFIER:
+  case INTCONST:
+    return true;
+  default:
+    return false;
+  }
+}
+
+static size_t cons_hash(NodeType node_type, ASTnode *child0, ASTnode *child1,
+                        Symbol *symbol, int num) {
+  uint64_t hash = 1469598103934665603ull;
+  uint64_t fields[] = {(uint64_t)node_type, (uint64_t)(uintptr_t)child0,
+                       (uint64_t)(uintptr_t)child1,
+                       (uint64_t)(uintptr_t)symbol, (uint64_t)(unsigned)num};
+  for (size_t i = 0; i < sizeof(fields) / sizeof(fields[0]); i++) {
+    hash = (hash ^ fields[i]) * 1099511628211ull;
+    hash ^= hash >> 29;
+  }
+  return (size_t)hash;
+}
 
-  node->node_type = node_type;
+static bool cons_matches(const ASTnode *node, NodeType node_type,
+                         ASTnode *child0, ASTnode *child1, Symbol *symbol,
+                         int num) {
+  return node->node_type == node_type && node->child0 == child0 &&
+         node->child1 == child1 && node->symbol == symbol && node->num == num;
+}
+
+static void cons_table_grow(ASTArena *arena) {
+  size_t capacity = arena->cons_capacity ? arena->cons_capacity * 2 : 256;
+  ASTnode **table = calloc(capacity, sizeof(ASTnode *));
+  if (!table) {
+    fprintf(stderr, "ERROR: Memory allocation failed\n");
+    exit(1);
+  }
+
+  for (size_t i = 0; i < arena->cons_capacity; i++) {
+    ASTnode *node = arena->cons_table[i];
+    if (node == NULL) {
+      continue;
+    }
+    size_t slot = cons_hash(node->node_type, node->child0, node->child1,
+                            node->symbol, node->num) &
+                  (capacity - 1);
+    while (table[slot] != NULL) {
+      slot = (slot + 1) & (capacity - 1);
+    }
+    table[slot] = node;
+  }
+
+  free(arena->cons_table);
+  arena->cons_table = table;
+  arena->cons_capacity = capacity;
+}
+
+// Creates an expression node, or in hash-consing mode returns the one that
+// was already made for the same fields. A node is shared only if its
+// children are, so nothing with a call below it ever is.
+static ASTnode *create_expr_node(NodeType node_type, ASTnode *child0,
+                                 ASTnode *child1, Symbol *symbol, int num) {
+  ASTArena *arena = active_arena();
+  bool share = arena->hash_consing && is_pure_kind(node_type) &&
+               (child0 == NULL || child0->shared) &&
+               (child1 == NULL || child1->shared);
+
+  size_t slot = 0;
+  if (share) {
+    if ((arena->cons_count + 1) * 10 > arena->cons_capacity * 7) {
+      cons_table_grow(arena);
+    }
+    size_t mask = arena->cons_capacity - 1;
+    slot = cons_hash(node_type, child0, child1, symbol, num) & mask;
+    for (ASTnode *node = arena->cons_table[slot]; node != NULL;
+         node = arena->cons_table[slot]) {
+      if (cons_matches(node, node_type, child0, child1, symbol, num)) {
+        arena->cons_hits++;
+        return node;
+      }
+      slot = (slot + 1) & mask;
+    }
+  }
+
+  ASTnode *node = create_ast_node(node_type);
   node->child0 = child0;
+  node->child1 = child1;
+  node->symbol = symbol;
+  node->num = num;
+
+  if (share) {
+    node->shared = true;
+    arena->cons_table[slot] = node;
+    arena->cons_count++;
+  }
 
   return node;
 }
 
+ASTnode *create_one_child_node(NodeType node_type, ASTnode *child0) {
+  return create_expr_node(node_type, child0, NULL, NULL, 0);
+}
+
 ASTnode *create_two_child_node(NodeType node_type, ASTnode *child0,
                                ASTnode *child1) {
-  ASTnode *node = create_one_child_node(node_type, child0);
-  node->child1 = child1;
-
-  return node;
+  return create_expr_node(node_type, child0, child1, NULL, 0);
 }
 
 ASTnode *create_three_child_node(NodeType node_type, ASTnode *child0,
                                  ASTnode *child1, ASTnode *child2) {
-  ASTnode *node = create_two_child_node(node_type, child0, child1);
+  ASTnode *node = create_ast_node(node_type);
+  node->child0 = child0;
+  node->child1 = child1;
   node->child2 = child2;
 
   return node;
 }
 
+// The items are copied, so the caller can reuse its array
+static ASTnode *create_list_node(NodeType node_type, ASTnode **items,
+                                 int count) {
+  ASTnode *node = create_ast_node(node_type);
+
+  node->count = count;
+  node->items = ast_arena_alloc(active_arena(), count * sizeof(ASTnode *));
+  memcpy(node->items, items, count * sizeof(ASTnode *));
+
+  return node;
+}
+
 ASTnode *create_add_node(ASTnode *child0, ASTnode *child1) {
   return create_two_child_node(ADD, child0, child1);
 }
@@ -67,8 +354,8 @@ ASTnode *create_eq_node(ASTnode *child0, ASTnode *child1) {
   return create_two_child_node(EQ, child0, child1);
 }
 
-ASTnode *create_expr_list_node(ASTnode *child0, ASTnode *child1) {
-  return create_two_child_node(EXPR_LIST, child0, child1);
+ASTnode *create_expr_list_node(ASTnode **items, int count) {
+  return create_list_node(EXPR_LIST, items, count);
 }
 
 ASTnode *create_func_call_node(Symbol *function_name, ASTnode *child0) {
@@ -92,11 +379,7 @@ ASTnode *create_gt_node(ASTnode *child0, ASTnode *child1) {
 
 ASTnode *create_identifier_node(Symbol *id_name) {
   assert(id_name);
-  ASTnode *id_node = create_ast_node();
-  id_node->symbol = id_name;
-  id_node->node_type = IDENTIFIER;
-
-  return id_node;
+  return create_expr_node(IDENTIFIER, NULL, NULL, id_name, 0);
 }
 
 ASTnode *create_if_node(ASTnode *child0, ASTnode *child1, ASTnode *child2) {
@@ -104,10 +387,7 @@ ASTnode *create_if_node(ASTnode *child0, ASTnode *child1, ASTnode *child2) {
 }
 
 ASTnode *create_intconst_node(int num) {
-  ASTnode *intconst_node = create_ast_node();
-  intconst_node->node_type = INTCONST;
-  intconst_node->num = num;
-  return intconst_node;
+  return create_expr_node(INTCONST, NULL, NULL, NULL, num);
 }
 
 ASTnode *create_le_node(ASTnode *child0, ASTnode *child1) {
@@ -126,16 +406,27 @@ ASTnode *create_ne_node(ASTnode *child0, ASTnode *child1) {
   return create_two_child_node(NE, child0, child1);
 }
 
+ASTnode *create_not_node(ASTnode *child0) {
+  return create_one_child_node(NOT, child0);
+}
+
 ASTnode *create_or_node(ASTnode *child0, ASTnode *child1) {
   return create_two_child_node(OR, child0, child1);
 }
 
+ASTnode *create_relop_node(NodeType node_type, ASTnode *child0,
+                           ASTnode *child1) {
+  assert(node_type == EQ || node_type == NE || node_type == LT ||
+         node_type == LE || node_type == GT || node_type == GE);
+  return create_two_child_node(node_type, child0, child1);
+}
+
 ASTnode *create_return_node(ASTnode *child0) {
   return create_one_child_node(RETURN, child0);
 }
 
-ASTnode *create_stmt_list_node(ASTnode *child0, ASTnode *child1) {
-  return create_two_child_node(STMT_LIST, child0, child1);
+ASTnode *create_stmt_list_node(ASTnode **items, int count) {
+  return create_list_node(STMT_LIST, items, count);
 }
 
 ASTnode *create_sub_node(ASTnode *child0, ASTnode *child1) {
@@ -153,21 +444,81 @@ ASTnode *create_while_node(ASTnode *child0, ASTnode *child1) {
  * for the AST node ptr points to.
  */
 NodeType ast_node_type(void *ptr) {
+  assert(ptr != NULL);
+  if (ast_store_is_handle(ptr)) {
+    return ast_store_kind(ptr);
+  }
   ASTnode *node = ptr;
-  assert(node != NULL);
   return node->node_type;
 }
 
+static bool is_list_type(NodeType node_type) {
+  return node_type == STMT_LIST || node_type == EXPR_LIST;
+}
+
+/*
+ * ptr: an arbitrary non-NULL AST pointer; ast_node_nchildren() returns the
+ * number of child slots of that node: the item count for a STMT_LIST or
+ * EXPR_LIST, 3 for any other node (slots may be NULL).
+ */
+int ast_node_nchildren(void *ptr) {
+  assert(ptr != NULL);
+  if (ast_store_is_handle(ptr)) {
+    return ast_store_nchildren(ptr);
+  }
+  ASTnode *node = ptr;
+  return is_list_type(node->node_type) ? node->count : 3;
+}
+
+/*
+ * ptr: an arbitrary non-NULL AST pointer, 0 <= n < ast_node_nchildren(ptr);
+ * ast_node_child() returns a pointer to the nth child of that node, or NULL
+ * if that slot is empty.
+ */
+void *ast_node_child(void *ptr, int n) {
+  assert(ptr != NULL);
+  if (ast_store_is_handle(ptr)) {
+    return ast_store_child(ptr, n);
+  }
+  ASTnode *node = ptr;
+  if (is_list_type(node->node_type)) {
+    assert(n >= 0 && n < node->count);
+    return node->items[n];
+  }
+  switch (n) {
+  case 0:
+    return node->child0;
+  case 1:
+    return node->child1;
+  case 2:
+    return node->child2;
+  default:
+    return NULL;
+  }
+}
+
+/*
+ * ptr: pointer to an AST node for an identifier, a function call or a function
+ * definition; ast_node_symbol() returns the symbol table entry it refers to.
+ */
+Symbol *ast_node_symbol(void *ptr) {
+  assert(ptr != NULL);
+  if (ast_store_is_handle(ptr)) {
+    return ast_store_symbol(ptr);
+  }
+  ASTnode *node = ptr;
+  return is_list_type(node->node_type) ? NULL : node->symbol;
+}
+
 /*
  * ptr: pointer to an AST for a function definition; func_def_name() returns
  * a pointer to the function name (a string) of the function definition AST that
  * ptr points to.
  */
 char *func_def_name(void *ptr) {
-  ASTnode *node = ptr;
-  assert(node != NULL);
-  assert(node->symbol);
-  return node->symbol->name;
+  Symbol *symbol = ast_node_symbol(ptr);
+  assert(symbol);
+  return symbol->name;
 }
 
 /*
@@ -175,10 +526,9 @@ char *func_def_name(void *ptr) {
  * the number of formal parameters for that function.
  */
 int func_def_nargs(void *ptr) {
-  ASTnode *node = ptr;
-  assert(node != NULL);
-  assert(node->symbol);
-  return node->symbol->number_of_arguments;
+  Symbol *symbol = ast_node_symbol(ptr);
+  assert(symbol);
+  return symbol->number_of_arguments;
 }
 
 /*
@@ -189,21 +539,20 @@ int func_def_nargs(void *ptr) {
  * n is outside these parameters, the behavior of this function is undefined.
  */
 char *func_def_argname(void *ptr, int n) {
-  ASTnode *node = ptr;
-  assert(node != NULL);
-  if (node->node_type != FUNC_DEF) {
+  if (ast_node_type(ptr) != FUNC_DEF) {
     exit(1);
   }
 
-  assert(node->symbol);
+  Symbol *symbol = ast_node_symbol(ptr);
+  assert(symbol);
 
-  if (n <= 0 || n > node->symbol->number_of_arguments) {
+  if (n <= 0 || n > symbol->number_of_arguments) {
     exit(1);
   }
 
-  assert(node->symbol->arguments);
+  assert(symbol->arguments);
 
-  Symbol *formal = node->symbol->arguments;
+  Symbol *formal = symbol->arguments;
   for (int i = 1; i < n; i++) {
     formal = formal->next;
   }
@@ -217,9 +566,8 @@ char *func_def_argname(void *ptr, int n) {
  * points to.
  */
 void *func_def_body(void *ptr) {
-  ASTnode *node = ptr;
-  assert(node != NULL);
-  return node->child0;
+  assert(ptr != NULL);
+  return ast_node_child(ptr, 0);
 }
 
 /*
@@ -227,9 +575,7 @@ void *func_def_body(void *ptr) {
  * a pointer to a string that is the name of the function being called.
  */
 char *func_call_callee(void *ptr) {
-  ASTnode *node = ptr;
-  assert(node != NULL);
-  return node->symbol->name;
+  return ast_node_symbol(ptr)->name;
 }
 
 /*
@@ -237,51 +583,46 @@ char *func_call_callee(void *ptr) {
  * a pointer to the AST that is the list of arguments to the call.
  */
 void *func_call_args(void *ptr) {
-  ASTnode *node = ptr;
-  assert(node != NULL);
-  return node->child0;
+  assert(ptr != NULL);
+  return ast_node_child(ptr, 0);
 }
 
 /*
- * ptr: pointer to an AST node for a statement list; stmt_list_head() returns
- * a pointer to the AST of the statement at the beginning of this list.
+ * ptr: pointer to an AST node for a statement list; stmt_list_length()
+ * returns the number of statements in the list.
  */
-void *stmt_list_head(void *ptr) {
-  ASTnode *node = ptr;
-  assert(node != NULL);
-  return node->child0;
+int stmt_list_length(void *ptr) {
+  assert(ptr != NULL);
+  return ast_node_nchildren(ptr);
 }
 
 /*
- * ptr: pointer to an AST node for a statement list; stmt_list_rest() returns
- * a pointer to the AST of the rest of this list (i.e., the pointer to the
- * next node in the list).
+ * ptr: pointer to an AST node for a statement list, n is an integer with
+ * 1 <= n <= stmt_list_length(ptr); stmt_list_nth() returns a pointer to the
+ * AST of the nth statement of the list.
  */
-void *stmt_list_rest(void *ptr) {
-  ASTnode *node = ptr;
-  assert(node != NULL);
-  return node->child1;
+void *stmt_list_nth(void *ptr, int n) {
+  assert(n >= 1 && n <= stmt_list_length(ptr));
+  return ast_node_child(ptr, n - 1);
 }
 
 /*
- * ptr: pointer to an AST node for an expression list; expr_list_head() returns
- * a pointer to the AST of the expression at the beginning of this list.
+ * ptr: pointer to an AST node for an expression list; expr_list_length()
+ * returns the number of expressions in the list.
  */
-void *expr_list_head(void *ptr) {
-  ASTnode *node = ptr;
-  assert(node != NULL);
-  return node->child0;
+int expr_list_length(void *ptr) {
+  assert(ptr != NULL);
+  return ast_node_nchildren(ptr);
 }
 
 /*
- * ptr: pointer to an AST node for an expression list; expr_list_rest() returns
- * a pointer to the AST of the rest of this list (i.e., the pointer to the
- * next node in the list).
+ * ptr: pointer to an AST node for an expression list, n is an integer with
+ * 1 <= n <= expr_list_length(ptr); expr_list_nth() returns a pointer to the
+ * AST of the nth expression of the list.
  */
-void *expr_list_rest(void *ptr) {
-  ASTnode *node = ptr;
-  assert(node != NULL);
-  return node->child1;
+void *expr_list_nth(void *ptr, int n) {
+  assert(n >= 1 && n <= expr_list_length(ptr));
+  return ast_node_child(ptr, n - 1);
 }
 
 /*
@@ -289,9 +630,7 @@ void *expr_list_rest(void *ptr) {
  * pointer to the name of the identifier (a string).
  */
 char *expr_id_name(void *ptr) {
-  ASTnode *node = ptr;
-  assert(node != NULL);
-  return node->symbol->name;
+  return ast_node_symbol(ptr)->name;
 }
 
 /*
@@ -299,8 +638,11 @@ char *expr_id_name(void *ptr) {
  * integer value of the constant.
  */
 int expr_intconst_val(void *ptr) {
+  assert(ptr != NULL);
+  if (ast_store_is_handle(ptr)) {
+    return ast_store_num(ptr);
+  }
   ASTnode *node = ptr;
-  assert(node != NULL);
   return node->num;
 }
 
@@ -309,9 +651,8 @@ int expr_intconst_val(void *ptr) {
  * expr_operand_1() returns a pointer to the AST of the first operand.
  */
 void *expr_operand_1(void *ptr) {
-  ASTnode *node = ptr;
-  assert(node != NULL);
-  return node->child0;
+  assert(ptr != NULL);
+  return ast_node_child(ptr, 0);
 }
 
 /*
@@ -319,9 +660,8 @@ void *expr_operand_1(void *ptr) {
  * expr_operand_2() returns a pointer to the AST of the second operand.
  */
 void *expr_operand_2(void *ptr) {
-  ASTnode *node = ptr;
-  assert(node != NULL);
-  return node->child1;
+  assert(ptr != NULL);
+  return ast_node_child(ptr, 1);
 }
 
 /*
@@ -329,9 +669,8 @@ void *expr_operand_2(void *ptr) {
  * a pointer to the AST for the expression tested by the if statement.
  */
 void *stmt_if_expr(void *ptr) {
-  ASTnode *node = ptr;
-  assert(node != NULL);
-  return node->child0;
+  assert(ptr != NULL);
+  return ast_node_child(ptr, 0);
 }
 
 /*
@@ -340,9 +679,8 @@ void *stmt_if_expr(void *ptr) {
  * statement to be executed if the condition is true.
  */
 void *stmt_if_then(void *ptr) {
-  ASTnode *node = ptr;
-  assert(node != NULL);
-  return node->child1;
+  assert(ptr != NULL);
+  return ast_node_child(ptr, 1);
 }
 
 /*
@@ -351,9 +689,8 @@ void *stmt_if_then(void *ptr) {
  * statement to be executed if the condition is false.
  */
 void *stmt_if_else(void *ptr) {
-  ASTnode *node = ptr;
-  assert(node != NULL);
-  return node->child2;
+  assert(ptr != NULL);
+  return ast_node_child(ptr, 2);
 }
 
 /*
@@ -362,12 +699,13 @@ void *stmt_if_else(void *ptr) {
  * assignment.
  */
 char *stmt_assg_lhs(void *ptr) {
-  ASTnode *node = ptr;
-  assert(node);
-  assert(node->child0);
-  assert(node->child0->symbol);
-  assert(node->child0->symbol->name);
-  return node->child0->symbol->name;
+  assert(ptr);
+  void *lhs = ast_node_child(ptr, 0);
+  assert(lhs);
+  Symbol *symbol = ast_node_symbol(lhs);
+  assert(symbol);
+  assert(symbol->name);
+  return symbol->name;
 }
 
 /*
@@ -375,9 +713,8 @@ char *stmt_assg_lhs(void *ptr) {
  * returns a pointer to the AST of the expression on the RHS of the assignment.
  */
 void *stmt_assg_rhs(void *ptr) {
-  ASTnode *node = ptr;
-  assert(node != NULL);
-  return node->child1;
+  assert(ptr != NULL);
+  return ast_node_child(ptr, 1);
 }
 
 /*
@@ -385,9 +722,8 @@ void *stmt_assg_rhs(void *ptr) {
  * returns a pointer to the AST of the expression tested by the while statement.
  */
 void *stmt_while_expr(void *ptr) {
-  ASTnode *node = ptr;
-  assert(node != NULL);
-  return node->child0;
+  assert(ptr != NULL);
+  return ast_node_child(ptr, 0);
 }
 
 /*
@@ -395,9 +731,8 @@ void *stmt_while_expr(void *ptr) {
  * returns a pointer to the AST of the body of the while statement.
  */
 void *stmt_while_body(void *ptr) {
-  ASTnode *node = ptr;
-  assert(node != NULL);
-  return node->child1;
+  assert(ptr != NULL);
+  return ast_node_child(ptr, 1);
 }
 
 /*
@@ -405,7 +740,178 @@ void *stmt_while_body(void *ptr) {
  * returns a pointer to the AST of the expression whose value is returned.
  */
 void *stmt_return_expr(void *ptr) {
-  ASTnode *node = ptr;
-  assert(node != NULL);
-  return node->child0;
+  assert(ptr != NULL);
+  return ast_node_child(ptr, 0);
+}
+
+/*******************************************************************************
+ *                                                                             *
+ *                                 TREE WALKER                                 *
+ *                                                                             *
+ *******************************************************************************/
+
+typedef struct {
+  void *node;
+  void *parent;
+  int depth;
+  int next_child; // next child slot to push; -1 until pre has run
+} WalkFrame;
+
+// Frames kept on the C stack before the walk moves to a heap buffer
+#define WALK_INLINE_FRAMES 64
+
+bool ast_walk(void *root, const ASTVisitor *visitor) {
+  if (root == NULL) {
+    return true;
+  }
+
+  WalkFrame inline_frames[WALK_INLINE_FRAMES];
+  WalkFrame *stack = inline_frames;
+  int capacity = WALK_INLINE_FRAMES;
+  int top = 0;
+  bool finished = true;
+
+  stack[top++] = (WalkFrame){root, NULL, 0, -1};
+
+  while (top > 0) {
+    WalkFrame *frame = &stack[top - 1];
+
+    if (frame->next_child < 0) {
+      ASTVisitResult result = AST_VISIT_CONTINUE;
+      if (visitor->pre) {
+        result = visitor->pre(frame->node, frame->parent, frame->depth,
+                              visitor->context);
+      }
+      if (result == AST_VISIT_STOP) {
+        finished = false;
+        break;
+      }
+      // Skipping the children still runs post for this node
+      frame->next_child = (result == AST_VISIT_SKIP_CHILDREN)
+                              ? ast_node_nchildren(frame->node)
+                              : 0;
+    }
+
+    // Find the next non-NULL child to descend into
+    void *child = NULL;
+    int nchildren = ast_node_nchildren(frame->node);
+    while (child == NULL && frame->next_child < nchildren) {
+      child = ast_node_child(frame->node, frame->next_child++);
+    }
+
+    if (child != NULL) {
+      if (top == capacity) {
+        int new_capacity = capacity * 2;
+        WalkFrame *new_stack;
+        if (stack == inline_frames) {
+          new_stack = malloc(new_capacity * sizeof(WalkFrame));
+          if (new_stack) {
+            memcpy(new_stack, stack, top * sizeof(WalkFrame));
+          }
+        } else {
+          new_stack = realloc(stack, new_capacity * sizeof(WalkFrame));
+        }
+        if (!new_stack) {
+          fprintf(stderr, "ERROR: Memory allocation failed\n");
+          exit(1);
+        }
+        stack = new_stack;
+        capacity = new_capacity;
+        frame = &stack[top - 1];
+      }
+      stack[top] = (WalkFrame){child, frame->node, frame->depth + 1, -1};
+      top++;
+      continue;
+    }
+
+    // All children done
+    if (visitor->post &&
+        visitor->post(frame->node, frame->parent, frame->depth,
+                      visitor->context) == AST_VISIT_STOP) {
+      finished = false;
+      break;
+    }
+    top--;
+  }
+
+  if (stack != inline_frames) {
+    free(stack);
+  }
+  return finished;
+}
+
+static ASTVisitResult stop_at_call(void *node, void *parent, int depth,
+                                   void *context) {
+  (void)parent;
+  (void)depth;
+  (void)context;
+  return (ast_node_type(node) == FUNC_CALL) ? AST_VISIT_STOP
+                                            : AST_VISIT_CONTINUE;
+}
+
+bool ast_contains_call(void *node) {
+  const ASTVisitor find_call = {stop_at_call, NULL, NULL};
+  // The walk is cut short exactly when a call is found
+  return !ast_walk(node, &find_call);
+}
+
+bool ast_right_operand_first(void *node) {
+  return ast_contains_call(expr_operand_2(node)) &&
+         !ast_contains_call(expr_operand_1(node));
+}
+
+/*******************************************************************************
+ *                                                                             *
+ *                                  TREE COPY                                  *
+ *                                                                             *
+ *******************************************************************************/
+
+ASTnode *ast_copy(ASTnode *node, ASTSymbolMapFn map_symbol, void *context) {
+  if (node == NULL) {
+    return NULL;
+  }
+
+  Symbol *symbol = NULL;
+  if (!is_list_type(node->node_type) && node->symbol != NULL) {
+    symbol = map_symbol ? map_symbol(node->symbol, context) : node->symbol;
+  }
+
+  if (is_list_type(node->node_type)) {
+    ASTnode **items = malloc(node->count * sizeof(ASTnode *));
+    if (node->count > 0 && !items) {
+      fprintf(stderr, "ERROR: Memory allocation failed\n");
+      exit(1);
+    }
+    for (int i = 0; i < node->count; i++) {
+      items[i] = ast_copy(node->items[i], map_symbol, context);
+    }
+    ASTnode *list = create_list_node(node->node_type, items, node->count);
+    free(items);
+    return list;
+  }
+
+  ASTnode *child0 = ast_copy(node->child0, map_symbol, context);
+  ASTnode *child1 = ast_copy(node->child1, map_symbol, context);
+  ASTnode *child2 = ast_copy(node->child2, map_symbol, context);
+
+  // Pure kinds go through create_expr_node() so the copy is hash-consed
+  // like the nodes the parser makes
+  if (is_pure_kind(node->node_type)) {
+    return create_expr_node(node->node_type, child0, child1, symbol,
+                            node->num);
+  }
+
+  ASTnode *copy = create_three_child_node(node->node_type, child0, child1,
+                                          child2);
+  copy->symbol = symbol;
+  copy->num = node->num;
+  return copy;
+}
+
+Symbol *ast_keep_symbol(Symbol *symbol, void *context) {
+  (void)context;
+  if (symbol->flags & SYMBOL_LOCAL) {
+    return copy_symbol(symbol, active_arena());
+  }
+  return symbol;
 }
@@ -8,6 +8,9 @@
 #define __AST_H__
 
 #include "symbol_table.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
 
 /*******************************************************************************
  *                                                                             *
@@ -34,7 +37,8 @@ typedef enum {
   LT,         /* < */
   MUL,        /* * */
   NE,         /* != */
-  OR,          /* || */
+  NOT,        /* ! */
+  OR,         /* || */
   RETURN,     /* return statement */
   STMT_LIST,  /* list of statements */
   SUB,        /* - (binary) */
@@ -42,25 +46,86 @@ typedef enum {
   WHILE,      /* while statement */
 } NodeType;
 
+#define AST_NODE_TYPE_COUNT (WHILE + 1)
+
 typedef struct ast_node {
   NodeType node_type; // The node type of the ASTnode
-  Symbol *
-      symbol;            /* The symbol reference if the ASTnode is representing a symbol */
-  char *identifier_name; // (depreciated) Need this because local scope gets dropped after function runs
-  int num;               /* The integer constant value if the ASTnode is
-                            representing an integer constant */
+  bool shared;        // Made in hash-consing mode and possibly used in more
+                      // than one place; such a subtree never contains a call
+  union {
+    Symbol *symbol;          /* The symbol reference if the ASTnode is
+                                representing a symbol */
+    struct ast_node **items; /* The elements of a STMT_LIST or EXPR_LIST */
+  };
+  union {
+    int num;   /* The integer constant value if the ASTnode is
+                  representing an integer constant */
+    int count; /* The number of items in a STMT_LIST or EXPR_LIST */
+  };
   // Possible children (up to 3 depending on type)
   struct ast_node *child0;
   struct ast_node *child1;
   struct ast_node *child2;
 } ASTnode;
 
+/*******************************************************************************
+ *                                                                             *
+ *                               AST NODE ARENAS                               *
+ *                                                                             *
+ *******************************************************************************/
+
+/*
+ * Nodes are bump-allocated from the current arena and are never freed one at
+ * a time. Destroying an arena releases every node allocated from it at once,
+ * so an arena should live exactly as long as the trees built in it (one
+ * function, or the whole translation unit).
+ */
+typedef struct ASTArena ASTArena;
+
+ASTArena *ast_arena_create(void);
+
+/* arena must not be in use; this may run on a different thread than the one
+ * that built the trees */
+void ast_arena_destroy(ASTArena *arena);
+
+/*
+ * Makes arena the one that the create_*_node() functions allocate from and
+ * returns the previous one. With no arena set, a default arena that lives for
+ * the whole run is used.
+ */
+ASTArena *ast_arena_use(ASTArena *arena);
+
+/* Bump-allocates size bytes from arena; the memory is zero-filled. */
+void *ast_arena_alloc(ASTArena *arena, size_t size);
+
+/*
+ * In hash-consing mode the constructors for identifiers, constants and
+ * arithmetic and boolean operators return the node already made in arena
+ * for the same kind, children, symbol and constant, if there is one. Only
+ * subtrees without calls are shared, so two such subtrees compute the same
+ * value exactly when they are the same pointer. Shared nodes must not be
+ * changed while arena can still hand them out. Off by default.
+ */
+void ast_arena_set_hash_consing(ASTArena *arena, bool enabled);
+
+/* Allocation counters, kept per arena */
+size_t ast_arena_node_count(const ASTArena *arena, NodeType node_type);
+size_t ast_arena_node_bytes(const ASTArena *arena, NodeType node_type);
+size_t ast_arena_bytes_used(const ASTArena *arena);
+size_t ast_arena_bytes_reserved(const ASTArena *arena);
+/* Number of constructor calls answered with an existing node */
+size_t ast_arena_shared_count(const ASTArena *arena);
+void ast_arena_print_stats(const ASTArena *arena, FILE *out);
+
+/* Returns the enumerator name of node_type, e.g. "FUNC_DEF" */
+const char *ast_node_type_name(NodeType node_type);
+
 ASTnode *create_add_node(ASTnode *child0, ASTnode *child1);
 ASTnode *create_and_node(ASTnode *child0, ASTnode *child1);
 ASTnode *create_assg_node(ASTnode *child0, ASTnode *child1);
 ASTnode *create_div_node(ASTnode *child0, ASTnode *child1);
 ASTnode *create_eq_node(ASTnode *child0, ASTnode *child1);
-ASTnode *create_expr_list_node(ASTnode *child0, ASTnode *child1);
+ASTnode *create_expr_list_node(ASTnode **items, int count);
 ASTnode *create_func_call_node(Symbol *function_name, ASTnode *child0);
 ASTnode *create_func_defn_node(Symbol *function_name, ASTnode *child0);
 ASTnode *create_ge_node(ASTnode *child0, ASTnode *child1);
@@ -72,9 +137,13 @@ ASTnode *create_le_node(ASTnode *child0, ASTnode *child1);
 ASTnode *create_lt_node(ASTnode *child0, ASTnode *child1);
 ASTnode *create_mul_node(ASTnode *child0, ASTnode *child1);
 ASTnode *create_ne_node(ASTnode *child0, ASTnode *child1);
+ASTnode *create_not_node(ASTnode *child0);
 ASTnode *create_or_node(ASTnode *child0, ASTnode *child1);
+/* node_type is one of EQ, NE, LT, LE, GT, GE */
+ASTnode *create_relop_node(NodeType node_type, ASTnode *child0,
+                           ASTnode *child1);
 ASTnode *create_return_node(ASTnode *child0);
-ASTnode *create_stmt_list_node(ASTnode *child0, ASTnode *child1);
+ASTnode *create_stmt_list_node(ASTnode **items, int count);
 ASTnode *create_sub_node(ASTnode *child0, ASTnode *child1);
 ASTnode *create_while_node(ASTnode *child0, ASTnode *child1);
 
@@ -91,6 +160,26 @@ ASTnode *create_while_node(ASTnode *child0, ASTnode *child1);
  */
 NodeType ast_node_type(void *ptr);
 
+/*
+ * ptr: an arbitrary non-NULL AST pointer; ast_node_nchildren() returns the
+ * number of child slots of that node: the item count for a STMT_LIST or
+ * EXPR_LIST, 3 for any other node (slots may be NULL).
+ */
+int ast_node_nchildren(void *ptr);
+
+/*
+ * ptr: an arbitrary non-NULL AST pointer, 0 <= n < ast_node_nchildren(ptr);
+ * ast_node_child() returns a pointer to the nth child of that node, or NULL
+ * if that slot is empty.
+ */
+void *ast_node_child(void *ptr, int n);
+
+/*
+ * ptr: pointer to an AST node for an identifier, a function call or a function
+ * definition; ast_node_symbol() returns the symbol table entry it refers to.
+ */
+Symbol *ast_node_symbol(void *ptr);
+
 /*
  * ptr: pointer to an AST for a function definition; func_def_name() returns
  * a pointer to the function name (a string) of the function definition AST that
@@ -133,30 +222,30 @@ char *func_call_callee(void *ptr);
 void *func_call_args(void *ptr);
 
 /*
- * ptr: pointer to an AST node for a statement list; stmt_list_head() returns
- * a pointer to the AST of the statement at the beginning of this list.
+ * ptr: pointer to an AST node for a statement list; stmt_list_length()
+ * returns the number of statements in the list.
  */
-void *stmt_list_head(void *ptr);
+int stmt_list_length(void *ptr);
 
 /*
- * ptr: pointer to an AST node for a statement list; stmt_list_rest() returns
- * a pointer to the AST of the rest of this list (i.e., the pointer to the
- * next node in the list).
+ * ptr: pointer to an AST node for a statement list, n is an integer with
+ * 1 <= n <= stmt_list_length(ptr); stmt_list_nth() returns a pointer to the
+ * AST of the nth statement of the list.
  */
-void *stmt_list_rest(void *ptr);
+void *stmt_list_nth(void *ptr, int n);
 
 /*
- * ptr: pointer to an AST node for an expression list; expr_list_head() returns
- * a pointer to the AST of the expression at the beginning of this list.
+ * ptr: pointer to an AST node for an expression list; expr_list_length()
+ * returns the number of expressions in the list.
  */
-void *expr_list_head(void *ptr);
+int expr_list_length(void *ptr);
 
 /*
- * ptr: pointer to an AST node for an expression list; expr_list_rest() returns
- * a pointer to the AST of the rest of this list (i.e., the pointer to the
- * next node in the list).
+ * ptr: pointer to an AST node for an expression list, n is an integer with
+ * 1 <= n <= expr_list_length(ptr); expr_list_nth() returns a pointer to the
+ * AST of the nth expression of the list.
  */
-void *expr_list_rest(void *ptr);
+void *expr_list_nth(void *ptr, int n);
 
 /*
  * ptr: pointer to an AST node for an IDENTIFIER; expr_id_name() returns a
@@ -233,6 +322,78 @@ void *stmt_while_body(void *ptr);
  */
 void *stmt_return_expr(void *ptr);
 
+/*******************************************************************************
+ *                                                                             *
+ *                                 TREE WALKER                                 *
+ *                                                                             *
+ *******************************************************************************/
+
+typedef enum {
+  AST_VISIT_CONTINUE,      /* keep going */
+  AST_VISIT_SKIP_CHILDREN, /* from a pre callback: do not enter this node */
+  AST_VISIT_STOP,          /* end the walk right away */
+} ASTVisitResult;
+
+/*
+ * Callback for ast_walk(). node is never NULL; parent is NULL for the root
+ * and depth is 0 for the root.
+ */
+typedef ASTVisitResult (*ASTVisitFn)(void *node, void *parent, int depth,
+                                     void *context);
+
+typedef struct {
+  ASTVisitFn pre;  /* called before a node's children, may be NULL */
+  ASTVisitFn post; /* called after a node's children, may be NULL */
+  void *context;   /* passed to both callbacks */
+} ASTVisitor;
+
+/*
+ * ast_walk() visits the tree below root depth-first, children in order, and
+ * calls visitor->pre and visitor->post around each non-NULL node. It keeps
+ * its own stack on the heap, so deep trees do not use up the C stack. Works
+ * on any AST pointer the getters accept. Returns false if a callback stopped
+ * the walk, true otherwise.
+ */
+bool ast_walk(void *root, const ASTVisitor *visitor);
+
+/* Returns true if the tree below node contains a function call */
+bool ast_contains_call(void *node);
+
+/*
+ * The evaluation order of the language. Call arguments are evaluated right to
+ * left. The operands of a binary operator are evaluated left to right, except
+ * that the right operand goes first when it contains a call and the left one
+ * does not; ast_right_operand_first() tells which for a binary node. Code
+ * generation and the interpreter both follow this order, so calls with side
+ * effects behave the same under --run as in the generated code.
+ */
+bool ast_right_operand_first(void *node);
+
+/*******************************************************************************
+ *                                                                             *
+ *                                  TREE COPY                                  *
+ *                                                                             *
+ *******************************************************************************/
+
+/* Replaces a symbol while a tree is copied */
+typedef Symbol *(*ASTSymbolMapFn)(Symbol *symbol, void *context);
+
+/*
+ * ast_copy() builds a copy of the tree below node in the current arena and
+ * returns it. The symbol of each IDENTIFIER, FUNC_CALL and FUNC_DEF node is
+ * replaced by map_symbol(symbol, context), or kept when map_symbol is NULL.
+ * Only takes ASTnode pointers, not compact-store handles.
+ */
+ASTnode *ast_copy(ASTnode *node, ASTSymbolMapFn map_symbol, void *context);
+
+/*
+ * A map_symbol for copies that outlive the function they come from. Locals
+ * are released with the function's symbols (see symbol_use_arena()), so they
+ * are copied into the current arena; other symbols are kept. context is
+ * unused.
+ */
+Symbol *ast_keep_symbol(Symbol *symbol, void *context);
+
 /*******************************************************************************
  *                                                                             *
  *                         TOP-LEVEL AST PRINT ROUTINE                         *
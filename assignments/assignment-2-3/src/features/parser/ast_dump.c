@@ -0,0 +1,618 @@
+// ast_dump.c
+#include "ast_dump.h"
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// Defined in ast-print.c
+char *opname(NodeType ntype);
+
+#define AST_DUMP_BUFFER_SIZE (64 * 1024)
+#define SPACES_PER_INDENTATION_LEVEL 4
+
+struct ASTDumper {
+  int fd;
+  ASTDumpFormat format;
+  size_t used;
+  char buffer[AST_DUMP_BUFFER_SIZE];
+};
+
+ASTDumper *ast_dumper_create(int fd, ASTDumpFormat format) {
+  ASTDumper *dumper = malloc(sizeof(ASTDumper));
+  if (!dumper) {
+    fprintf(stderr, "ERROR: Memory allocation failed\n");
+    exit(1);
+  }
+
+  dumper->fd = fd;
+  dumper->format = format;
+  dumper->used = 0;
+
+  return dumper;
+}
+
+void ast_dumper_flush(ASTDumper *dumper) {
+  if (dumper->used == 0) {
+    return;
+  }
+
+  fflush(stdout);
+
+  const char *next = dumper->buffer;
+  size_t left = dumper->used;
+  while (left > 0) {
+    ssize_t written = write(dumper->fd, next, left);
+    if (written < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      fprintf(stderr, "ERROR: could not write the AST dump\n");
+      exit(1);
+    }
+    next += written;
+    left -= (size_t)written;
+  }
+
+  dumper->used = 0;
+}
+
+void ast_dumper_destroy(ASTDumper *dumper) {
+  if (!dumper) {
+    return;
+  }
+
+  ast_dumper_flush(dumper);
+  free(dumper);
+}
+
+bool ast_dump_format_from_name(const char *name, ASTDumpFormat *format) {
+  if (strcmp(name, "text") == 0) {
+    *format = AST_DUMP_TEXT;
+  } else if (strcmp(name, "json") == 0) {
+    *format = AST_DUMP_JSON;
+  } else if (strcmp(name, "sexpr") == 0) {
+    *format = AST_DUMP_SEXPR;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+/*******************************************************************************
+ *                                                                             *
+ *                                   OUTPUT                                    *
+ *                                                                             *
+ *******************************************************************************/
+
+static void put(ASTDumper *dumper, const char *text, size_t length) {
+  while (length > 0) {
+    if (dumper->used == AST_DUMP_BUFFER_SIZE) {
+      ast_dumper_flush(dumper);
+    }
+    size_t room = AST_DUMP_BUFFER_SIZE - dumper->used;
+    size_t chunk = (length < room) ? length : room;
+    memcpy(dumper->buffer + dumper->used, text, chunk);
+    dumper->used += chunk;
+    text += chunk;
+    length -= chunk;
+  }
+}
+
+static void put_str(ASTDumper *dumper, const char *text) {
+  put(dumper, text, strlen(text));
+}
+
+static void put_int(ASTDumper *dumper, int value) {
+  char digits[12];
+  char *end = digits + sizeof(digits);
+  char *start = end;
+  // Work on the magnitude as unsigned so INT_MIN needs no special case
+  unsigned magnitude = (value < 0) ? 0u - (unsigned)value : (unsigned)value;
+
+  do {
+    *--start = (char)('0' + magnitude % 10);
+    magnitude /= 10;
+  } while (magnitude > 0);
+  if (value < 0) {
+    *--start = '-';
+  }
+
+  put(dumper, start, (size_t)(end - start));
+}
+
+static void put_indent(ASTDumper *dumper, int count) {
+  static const char spaces[] = "                                ";
+  while (count > 0) {
+    int chunk = (count < (int)sizeof(spaces) - 1) ? count
+                                                  : (int)sizeof(spaces) - 1;
+    put(dumper, spaces, (size_t)chunk);
+    count -= chunk;
+  }
+}
+
+// JSON string; identifiers never need escaping, but names are escaped anyway
+static void put_json_string(ASTDumper *dumper, const char *text) {
+  put(dumper, "\"", 1);
+  for (const char *c = text; *c; c++) {
+    if (*c == '"' || *c == '\\') {
+      put(dumper, "\\", 1);
+      put(dumper, c, 1);
+    } else if ((unsigned char)*c < 0x20) {
+      char escape[8];
+      snprintf(escape, sizeof(escape), "\\u%04x", (unsigned char)*c);
+      put_str(dumper, escape);
+    } else {
+      put(dumper, c, 1);
+    }
+  }
+  put(dumper, "\"", 1);
+}
+
+/*******************************************************************************
+ *                                                                             *
+ *                                 TEXT FORMAT                                 *
+ *                                                                             *
+ *******************************************************************************/
+
+// Mirrors print_ast_formatted() in ast-print.c: n is the indentation level
+// and nl says whether a newline ends the node
+static void dump_text(ASTDumper *d, void *tree, int n, int nl) {
+  int indent_amt = n * SPACES_PER_INDENTATION_LEVEL;
+
+  if (tree == NULL) {
+    return;
+  }
+
+  NodeType ntype = ast_node_type(tree);
+
+  switch (ntype) {
+  case FUNC_DEF: {
+    char *name = func_def_name(tree);
+    put_str(d, "func_def: ");
+    put_str(d, name);
+    put_str(d, "\n  formals: ");
+    int nargs = func_def_nargs(tree);
+    for (int i = 1; i <= nargs; i++) {
+      put_str(d, func_def_argname(tree, i));
+      if (i < nargs) {
+        put_str(d, ", ");
+      }
+    }
+    put_str(d, "\n  body:\n");
+    dump_text(d, func_def_body(tree), n + 1, 1);
+    put_str(d, "/* func_def: ");
+    put_str(d, name);
+    put_str(d, " */\n\n");
+    break;
+  }
+
+  case FUNC_CALL:
+    put_indent(d, indent_amt);
+    put_str(d, func_call_callee(tree));
+    put_str(d, "(");
+    dump_text(d, func_call_args(tree), 0, 0);
+    put_str(d, ")");
+    if (nl != 0) {
+      put_str(d, "\n");
+    }
+    break;
+
+  case STMT_LIST: {
+    put_indent(d, indent_amt);
+    put_str(d, "{\n");
+    int nstmts = stmt_list_length(tree);
+    for (int i = 1; i <= nstmts; i++) {
+      dump_text(d, stmt_list_nth(tree, i), n + 1, nl);
+    }
+    put_indent(d, indent_amt);
+    put_str(d, "}\n");
+    break;
+  }
+
+  case IF:
+    put_indent(d, indent_amt);
+    put_str(d, "if (");
+    dump_text(d, stmt_if_expr(tree), 0, 0);
+    put_str(d, "):\n");
+    put_indent(d, indent_amt);
+    put_str(d, "then:\n");
+    dump_text(d, stmt_if_then(tree), n + 1, nl);
+    put_indent(d, indent_amt);
+    put_str(d, "else:\n");
+    dump_text(d, stmt_if_else(tree), n + 1, nl);
+    put_indent(d, indent_amt);
+    put_str(d, "end_if\n");
+    break;
+
+  case ASSG:
+    put_indent(d, indent_amt);
+    put_str(d, stmt_assg_lhs(tree));
+    put_str(d, " = ");
+    dump_text(d, stmt_assg_rhs(tree), 0, 0);
+    put_str(d, "\n");
+    break;
+
+  case WHILE:
+    put_indent(d, indent_amt);
+    put_str(d, "while (");
+    dump_text(d, stmt_while_expr(tree), 0, 0);
+    put_str(d, "):\n");
+    dump_text(d, stmt_while_body(tree), n + 1, 1);
+    put_indent(d, indent_amt);
+    put_str(d, "end_while\n");
+    break;
+
+  case RETURN:
+    put_indent(d, indent_amt);
+    put_str(d, "return: ");
+    dump_text(d, stmt_return_expr(tree), 0, 0);
+    put_str(d, "\n");
+    break;
+
+  case EXPR_LIST: {
+    int nexprs = expr_list_length(tree);
+    for (int i = 1; i <= nexprs; i++) {
+      dump_text(d, expr_list_nth(tree, i), 0, 0);
+      if (i < nexprs) {
+        put_str(d, ", ");
+      }
+    }
+    break;
+  }
+
+  case IDENTIFIER:
+    put_str(d, expr_id_name(tree));
+    break;
+
+  case INTCONST:
+    put_int(d, expr_intconst_val(tree));
+    break;
+
+  case NOT:
+  case UMINUS:
+    put_str(d, (ntype == NOT) ? "!(" : "-(");
+    dump_text(d, expr_operand_1(tree), 0, 0);
+    put_str(d, ")");
+    break;
+
+  case EQ:
+  case NE:
+  case LE:
+  case LT:
+  case GE:
+  case GT:
+    dump_text(d, expr_operand_1(tree), 0, 0);
+    put_str(d, " ");
+    put_str(d, opname(ntype));
+    put_str(d, " ");
+    dump_text(d, expr_operand_2(tree), 0, 0);
+    break;
+
+  case ADD:
+  case SUB:
+  case MUL:
+  case DIV:
+    put_str(d, "(");
+    dump_text(d, expr_operand_1(tree), 0, 0);
+    put_str(d, " ");
+    put_str(d, opname(ntype));
+    put_str(d, " ");
+    dump_text(d, expr_operand_2(tree), 0, 0);
+    put_str(d, ")");
+    break;
+
+  case AND:
+  case OR:
+    put_str(d, "(");
+    dump_text(d, expr_operand_1(tree), 0, 0);
+    put_str(d, ") ");
+    put_str(d, opname(ntype));
+    put_str(d, " (");
+    dump_text(d, expr_operand_2(tree), 0, 0);
+    put_str(d, ")");
+    break;
+
+  default:
+    fprintf(stderr, "*** [%s] Unrecognized syntax tree node type %d\n",
+            __func__, ntype);
+  }
+}
+
+/*******************************************************************************
+ *                                                                             *
+ *                                 JSON FORMAT                                 *
+ *                                                                             *
+ *******************************************************************************/
+
+static void dump_json(ASTDumper *d, void *tree);
+
+static void put_json_kind(ASTDumper *d, NodeType ntype) {
+  put_str(d, "{\"kind\":\"");
+  put_str(d, ast_node_type_name(ntype));
+  put_str(d, "\"");
+}
+
+// ,"key":value
+static void put_json_member(ASTDumper *d, const char *key, void *tree) {
+  put_str(d, ",\"");
+  put_str(d, key);
+  put_str(d, "\":");
+  dump_json(d, tree);
+}
+
+static void put_json_items(ASTDumper *d, void *list, bool statements) {
+  put_str(d, ",\"items\":[");
+  int count = statements ? stmt_list_length(list) : expr_list_length(list);
+  for (int i = 1; i <= count; i++) {
+    if (i > 1) {
+      put_str(d, ",");
+    }
+    dump_json(d, statements ? stmt_list_nth(list, i) : expr_list_nth(list, i));
+  }
+  put_str(d, "]");
+}
+
+static void dump_json(ASTDumper *d, void *tree) {
+  if (tree == NULL) {
+    put_str(d, "null");
+    return;
+  }
+
+  NodeType ntype = ast_node_type(tree);
+  put_json_kind(d, ntype);
+
+  switch (ntype) {
+  case FUNC_DEF: {
+    put_str(d, ",\"name\":");
+    put_json_string(d, func_def_name(tree));
+    put_str(d, ",\"formals\":[");
+    int nargs = func_def_nargs(tree);
+    for (int i = 1; i <= nargs; i++) {
+      if (i > 1) {
+        put_str(d, ",");
+      }
+      put_json_string(d, func_def_argname(tree, i));
+    }
+    put_str(d, "]");
+    put_json_member(d, "body", func_def_body(tree));
+    break;
+  }
+
+  case FUNC_CALL:
+    put_str(d, ",\"callee\":");
+    put_json_string(d, func_call_callee(tree));
+    put_json_member(d, "args", func_call_args(tree));
+    break;
+
+  case STMT_LIST:
+    put_json_items(d, tree, true);
+    break;
+
+  case EXPR_LIST:
+    put_json_items(d, tree, false);
+    break;
+
+  case IF:
+    put_json_member(d, "cond", stmt_if_expr(tree));
+    put_json_member(d, "then", stmt_if_then(tree));
+    put_json_member(d, "else", stmt_if_else(tree));
+    break;
+
+  case WHILE:
+    put_json_member(d, "cond", stmt_while_expr(tree));
+    put_json_member(d, "body", stmt_while_body(tree));
+    break;
+
+  case ASSG:
+    put_str(d, ",\"lhs\":");
+    put_json_string(d, stmt_assg_lhs(tree));
+    put_json_member(d, "rhs", stmt_assg_rhs(tree));
+    break;
+
+  case RETURN:
+    put_json_member(d, "value", stmt_return_expr(tree));
+    break;
+
+  case IDENTIFIER:
+    put_str(d, ",\"name\":");
+    put_json_string(d, expr_id_name(tree));
+    break;
+
+  case INTCONST:
+    put_str(d, ",\"value\":");
+    put_int(d, expr_intconst_val(tree));
+    break;
+
+  case NOT:
+  case UMINUS:
+    put_json_member(d, "operand", expr_operand_1(tree));
+    break;
+
+  case EQ:
+  case NE:
+  case LE:
+  case LT:
+  case GE:
+  case GT:
+  case ADD:
+  case SUB:
+  case MUL:
+  case DIV:
+  case AND:
+  case OR:
+    put_json_member(d, "lhs", expr_operand_1(tree));
+    put_json_member(d, "rhs", expr_operand_2(tree));
+    break;
+
+  default:
+    break;
+  }
+
+  put_str(d, "}");
+}
+
+/*******************************************************************************
+ *                                                                             *
+ *                             S-EXPRESSION FORMAT                             *
+ *                                                                             *
+ *******************************************************************************/
+
+static void dump_sexpr(ASTDumper *d, void *tree) {
+  if (tree == NULL) {
+    put_str(d, "nil");
+    return;
+  }
+
+  NodeType ntype = ast_node_type(tree);
+
+  switch (ntype) {
+  case FUNC_DEF: {
+    put_str(d, "(func ");
+    put_str(d, func_def_name(tree));
+    put_str(d, " (");
+    int nargs = func_def_nargs(tree);
+    for (int i = 1; i <= nargs; i++) {
+      if (i > 1) {
+        put_str(d, " ");
+      }
+      put_str(d, func_def_argname(tree, i));
+    }
+    put_str(d, ") ");
+    dump_sexpr(d, func_def_body(tree));
+    put_str(d, ")");
+    break;
+  }
+
+  case FUNC_CALL: {
+    put_str(d, "(call ");
+    put_str(d, func_call_callee(tree));
+    void *args = func_call_args(tree);
+    int nargs = (args != NULL) ? expr_list_length(args) : 0;
+    for (int i = 1; i <= nargs; i++) {
+      put_str(d, " ");
+      dump_sexpr(d, expr_list_nth(args, i));
+    }
+    put_str(d, ")");
+    break;
+  }
+
+  case STMT_LIST: {
+    put_str(d, "(block");
+    int nstmts = stmt_list_length(tree);
+    for (int i = 1; i <= nstmts; i++) {
+      put_str(d, " ");
+      dump_sexpr(d, stmt_list_nth(tree, i));
+    }
+    put_str(d, ")");
+    break;
+  }
+
+  case EXPR_LIST: {
+    put_str(d, "(list");
+    int nexprs = expr_list_length(tree);
+    for (int i = 1; i <= nexprs; i++) {
+      put_str(d, " ");
+      dump_sexpr(d, expr_list_nth(tree, i));
+    }
+    put_str(d, ")");
+    break;
+  }
+
+  case IF:
+    put_str(d, "(if ");
+    dump_sexpr(d, stmt_if_expr(tree));
+    put_str(d, " ");
+    dump_sexpr(d, stmt_if_then(tree));
+    put_str(d, " ");
+    dump_sexpr(d, stmt_if_else(tree));
+    put_str(d, ")");
+    break;
+
+  case WHILE:
+    put_str(d, "(while ");
+    dump_sexpr(d, stmt_while_expr(tree));
+    put_str(d, " ");
+    dump_sexpr(d, stmt_while_body(tree));
+    put_str(d, ")");
+    break;
+
+  case ASSG:
+    put_str(d, "(= ");
+    put_str(d, stmt_assg_lhs(tree));
+    put_str(d, " ");
+    dump_sexpr(d, stmt_assg_rhs(tree));
+    put_str(d, ")");
+    break;
+
+  case RETURN:
+    put_str(d, "(return");
+    if (stmt_return_expr(tree) != NULL) {
+      put_str(d, " ");
+      dump_sexpr(d, stmt_return_expr(tree));
+    }
+    put_str(d, ")");
+    break;
+
+  case IDENTIFIER:
+    put_str(d, expr_id_name(tree));
+    break;
+
+  case INTCONST:
+    put_int(d, expr_intconst_val(tree));
+    break;
+
+  case NOT:
+  case UMINUS:
+    put_str(d, "(");
+    put_str(d, opname(ntype));
+    put_str(d, " ");
+    dump_sexpr(d, expr_operand_1(tree));
+    put_str(d, ")");
+    break;
+
+  case EQ:
+  case NE:
+  case LE:
+  case LT:
+  case GE:
+  case GT:
+  case ADD:
+  case SUB:
+  case MUL:
+  case DIV:
+  case AND:
+  case OR:
+    put_str(d, "(");
+    put_str(d, opname(ntype));
+    put_str(d, " ");
+    dump_sexpr(d, expr_operand_1(tree));
+    put_str(d, " ");
+    dump_sexpr(d, expr_operand_2(tree));
+    put_str(d, ")");
+    break;
+
+  default:
+    put_str(d, "(");
+    put_str(d, ast_node_type_name(ntype));
+    put_str(d, ")");
+    break;
+  }
+}
+
+void ast_dump(ASTDumper *dumper, void *node) {
+  switch (dumper->format) {
+  case AST_DUMP_TEXT:
+    dump_text(dumper, node, 0, 1);
+    break;
+  case AST_DUMP_JSON:
+    dump_json(dumper, node);
+    put_str(dumper, "\n");
+    break;
+  case AST_DUMP_SEXPR:
+    dump_sexpr(dumper, node);
+    put_str(dumper, "\n");
+    break;
+  }
+}
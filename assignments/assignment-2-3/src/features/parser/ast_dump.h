@@ -0,0 +1,37 @@
+#ifndef AST_DUMP_H
+#define AST_DUMP_H
+
+#include "ast.h"
+
+/*
+ * Buffered AST output. Text is the --print_ast format, byte for byte. JSON
+ * writes one object per function per line, with a "kind" member naming the
+ * node type. S-expressions write one list per function per line, e.g.
+ * (func f (a) (block (= x (call g a)) (return x))), with nil for an empty
+ * slot. All three only use the getters, so they work on any AST pointer.
+ */
+typedef enum {
+  AST_DUMP_TEXT,
+  AST_DUMP_JSON,
+  AST_DUMP_SEXPR,
+} ASTDumpFormat;
+
+typedef struct ASTDumper ASTDumper;
+
+// Output goes to fd in large write() calls. Anything pending in stdout is
+// flushed before each write, so the dump keeps its place among printf output.
+ASTDumper *ast_dumper_create(int fd, ASTDumpFormat format);
+
+// Appends the tree below node to the dumper's buffer
+void ast_dump(ASTDumper *dumper, void *node);
+
+// Writes out everything buffered so far
+void ast_dumper_flush(ASTDumper *dumper);
+
+// Flushes and frees the dumper
+void ast_dumper_destroy(ASTDumper *dumper);
+
+// Parses "text", "json" or "sexpr"; returns false for anything else
+bool ast_dump_format_from_name(const char *name, ASTDumpFormat *format);
+
+#endif
@@ -0,0 +1,421 @@
+// ast_file.c
+#include "ast_file.h"
+#include "symbol_table.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define AST_FILE_MAGIC "CAST"
+#define AST_FILE_VERSION 2
+#define AST_FILE_BYTE_ORDER 0x01020304u
+#define AST_FILE_NONE UINT32_MAX
+
+typedef struct {
+  char magic[4];
+  uint32_t version;
+  uint32_t byte_order;
+  uint32_t file_size;
+
+  uint32_t node_count;
+  uint32_t list_item_count;
+  uint32_t symbol_count;
+  uint32_t string_bytes;
+
+  uint32_t kind_offset;
+  uint32_t child0_offset;
+  uint32_t child1_offset;
+  uint32_t child2_offset;
+  uint32_t payload_offset;
+  uint32_t list_items_offset;
+  uint32_t symbols_offset;
+  uint32_t strings_offset;
+} ASTFileHeader;
+
+typedef struct {
+  uint32_t name;      // offset in the string section
+  uint32_t kind;      // SymbolKind
+  int32_t offset;     // frame offset of a local or parameter
+  int32_t number_of_arguments;
+  int32_t local_var_bytes;
+  uint32_t arguments; // first formal of a function, or AST_FILE_NONE
+  uint32_t next;      // next formal in an argument list, or AST_FILE_NONE
+  uint32_t flags;     // SYMBOL_GLOBAL and the like
+} ASTFileSymbol;
+
+static bool has_symbol_payload(NodeType node_type) {
+  return node_type == IDENTIFIER || node_type == FUNC_CALL ||
+         node_type == FUNC_DEF;
+}
+
+static uint32_t align8(uint32_t size) { return (size + 7) & ~(uint32_t)7; }
+
+/*******************************************************************************
+ *                                                                             *
+ *                                   WRITING                                   *
+ *                                                                             *
+ *******************************************************************************/
+
+// Distinct symbols of a store, numbered in order of first use
+typedef struct {
+  Symbol **symbols;
+  uint32_t count;
+  uint32_t capacity;
+} FileSymbols;
+
+static uint32_t file_symbol_index(const FileSymbols *table,
+                                  const Symbol *symbol) {
+  for (uint32_t i = 0; i < table->count; i++) {
+    if (table->symbols[i] == symbol) {
+      return i;
+    }
+  }
+  return AST_FILE_NONE;
+}
+
+static uint32_t add_file_symbol(FileSymbols *table, Symbol *symbol) {
+  uint32_t index = file_symbol_index(table, symbol);
+  if (index != AST_FILE_NONE) {
+    return index;
+  }
+
+  if (table->count == table->capacity) {
+    table->capacity = table->capacity ? table->capacity * 2 : 16;
+    table->symbols =
+        realloc(table->symbols, table->capacity * sizeof(Symbol *));
+    if (!table->symbols) {
+      fprintf(stderr, "ERROR: Memory allocation failed\n");
+      exit(1);
+    }
+  }
+  table->symbols[table->count] = symbol;
+  return table->count++;
+}
+
+bool ast_file_write(const ASTStore *store, const char *path) {
+  // Symbols used by the tree, then the formals of every function among them
+  FileSymbols table = {NULL, 0, 0};
+  for (uint32_t i = 0; i < store->symbol_count; i++) {
+    add_file_symbol(&table, store->symbols[i]);
+  }
+  for (uint32_t i = 0; i < table.count; i++) {
+    Symbol *formal = table.symbols[i]->arguments;
+    for (; formal != NULL; formal = formal->next) {
+      add_file_symbol(&table, formal);
+    }
+  }
+
+  uint32_t string_bytes = 0;
+  for (uint32_t i = 0; i < table.count; i++) {
+    string_bytes += strlen(table.symbols[i]->name) + 1;
+  }
+
+  uint32_t nodes = store->node_count;
+  ASTFileHeader header = {0};
+  memcpy(header.magic, AST_FILE_MAGIC, sizeof(header.magic));
+  header.version = AST_FILE_VERSION;
+  header.byte_order = AST_FILE_BYTE_ORDER;
+  header.node_count = nodes;
+  header.list_item_count = store->list_item_count;
+  header.symbol_count = table.count;
+  header.string_bytes = string_bytes;
+
+  uint32_t size = align8(sizeof(ASTFileHeader));
+  header.kind_offset = size;
+  size = align8(size + nodes * sizeof(uint8_t));
+  header.child0_offset = size;
+  size = align8(size + nodes * sizeof(uint32_t));
+  header.child1_offset = size;
+  size = align8(size + nodes * sizeof(uint32_t));
+  header.child2_offset = size;
+  size = align8(size + nodes * sizeof(uint32_t));
+  header.payload_offset = size;
+  size = align8(size + nodes * sizeof(int32_t));
+  header.list_items_offset = size;
+  size = align8(size + store->list_item_count * sizeof(uint32_t));
+  header.symbols_offset = size;
+  size = align8(size + table.count * sizeof(ASTFileSymbol));
+  header.strings_offset = size;
+  size = align8(size + string_bytes);
+  header.file_size = size;
+
+  unsigned char *image = calloc(1, size);
+  if (!image) {
+    fprintf(stderr, "ERROR: Memory allocation failed\n");
+    exit(1);
+  }
+
+  memcpy(image, &header, sizeof(header));
+  memcpy(image + header.kind_offset, store->kind, nodes * sizeof(uint8_t));
+  memcpy(image + header.child0_offset, store->child0, nodes * sizeof(uint32_t));
+  memcpy(image + header.child1_offset, store->child1, nodes * sizeof(uint32_t));
+  memcpy(image + header.child2_offset, store->child2, nodes * sizeof(uint32_t));
+  memcpy(image + header.list_items_offset, store->list_items,
+         store->list_item_count * sizeof(uint32_t));
+
+  // Symbol payloads are renumbered to the file's symbol section
+  int32_t *payload = (int32_t *)(image + header.payload_offset);
+  for (uint32_t i = 0; i < nodes; i++) {
+    payload[i] = store->payload[i];
+    if (i > 0 && has_symbol_payload((NodeType)store->kind[i])) {
+      Symbol *symbol = store->symbols[payload[i]];
+      payload[i] = (int32_t)file_symbol_index(&table, symbol);
+    }
+  }
+
+  ASTFileSymbol *records = (ASTFileSymbol *)(image + header.symbols_offset);
+  char *strings = (char *)(image + header.strings_offset);
+  uint32_t string_end = 0;
+  for (uint32_t i = 0; i < table.count; i++) {
+    Symbol *symbol = table.symbols[i];
+    ASTFileSymbol *record = &records[i];
+
+    record->name = string_end;
+    strcpy(strings + string_end, symbol->name);
+    string_end += strlen(symbol->name) + 1;
+
+    record->kind = symbol->kind;
+
+    record->offset = symbol->offset;
+    record->number_of_arguments = symbol->number_of_arguments;
+    record->local_var_bytes = symbol->local_var_bytes;
+    record->arguments = symbol->arguments
+                            ? file_symbol_index(&table, symbol->arguments)
+                            : AST_FILE_NONE;
+    record->next = AST_FILE_NONE;
+    record->flags = symbol->flags;
+  }
+
+  // Only argument lists are kept; other next links belong to the scopes
+  for (uint32_t i = 0; i < table.count; i++) {
+    Symbol *formal = table.symbols[i]->arguments;
+    for (; formal != NULL && formal->next != NULL; formal = formal->next) {
+      records[file_symbol_index(&table, formal)].next =
+          file_symbol_index(&table, formal->next);
+    }
+  }
+
+  bool written = false;
+  FILE *file = fopen(path, "wb");
+  if (file) {
+    written = fwrite(image, 1, size, file) == size;
+    written = (fclose(file) == 0) && written;
+  }
+  if (!written) {
+    fprintf(stderr, "ERROR: could not write AST file %s\n", path);
+  }
+
+  free(image);
+  free(table.symbols);
+  return written;
+}
+
+/*******************************************************************************
+ *                                                                             *
+ *                                   LOADING                                   *
+ *                                                                             *
+ *******************************************************************************/
+
+// Nodes of a loaded store that are not global share this scope, so the
+// backend can tell them from globals
+static Scope loaded_local_scope;
+
+static bool section_fits(const ASTFileHeader *header, uint32_t offset,
+                         uint64_t bytes) {
+  return offset % 8 == 0 && offset >= sizeof(ASTFileHeader) &&
+         offset <= header->file_size &&
+         bytes <= header->file_size - offset;
+}
+
+static bool valid_string(const ASTFileHeader *header, uint32_t offset) {
+  return offset < header->string_bytes;
+}
+
+// Checks everything the getters rely on, so a damaged file is rejected here
+// instead of being read out of bounds later
+static bool valid_file(const unsigned char *base, size_t size) {
+  if (size < sizeof(ASTFileHeader)) {
+    return false;
+  }
+
+  const ASTFileHeader *header = (const ASTFileHeader *)base;
+  if (memcmp(header->magic, AST_FILE_MAGIC, 4) != 0 ||
+      header->version != AST_FILE_VERSION ||
+      header->byte_order != AST_FILE_BYTE_ORDER ||
+      header->file_size != size || header->node_count == 0) {
+    return false;
+  }
+
+  uint64_t nodes = header->node_count;
+  if (!section_fits(header, header->kind_offset, nodes) ||
+      !section_fits(header, header->child0_offset, nodes * 4) ||
+      !section_fits(header, header->child1_offset, nodes * 4) ||
+      !section_fits(header, header->child2_offset, nodes * 4) ||
+      !section_fits(header, header->payload_offset, nodes * 4) ||
+      !section_fits(header, header->list_items_offset,
+                    (uint64_t)header->list_item_count * 4) ||
+      !section_fits(header, header->symbols_offset,
+                    (uint64_t)header->symbol_count * sizeof(ASTFileSymbol)) ||
+      !section_fits(header, header->strings_offset, header->string_bytes)) {
+    return false;
+  }
+
+  // Every name has to end inside the string section
+  const char *strings = (const char *)(base + header->strings_offset);
+  if (header->string_bytes > 0 && strings[header->string_bytes - 1] != '\0') {
+    return false;
+  }
+
+  const uint8_t *kind = base + header->kind_offset;
+  const uint32_t *children[3] = {
+      (const uint32_t *)(base + header->child0_offset),
+      (const uint32_t *)(base + header->child1_offset),
+      (const uint32_t *)(base + header->child2_offset)};
+  const int32_t *payload = (const int32_t *)(base + header->payload_offset);
+  const uint32_t *list_items =
+      (const uint32_t *)(base + header->list_items_offset);
+
+  for (uint32_t i = 1; i < header->node_count; i++) {
+    if (kind[i] >= AST_NODE_TYPE_COUNT) {
+      return false;
+    }
+    // Children come after their parent in pre-order, which also rules out
+    // cycles
+    for (int c = 0; c < 3; c++) {
+      uint32_t child = children[c][i];
+      if (child >= header->node_count || (child != 0 && child <= i)) {
+        return false;
+      }
+    }
+
+    if (kind[i] == STMT_LIST || kind[i] == EXPR_LIST) {
+      uint32_t offset = (uint32_t)payload[i];
+      if (offset >= header->list_item_count ||
+          list_items[offset] > header->list_item_count - offset - 1) {
+        return false;
+      }
+      for (uint32_t n = 1; n <= list_items[offset]; n++) {
+        uint32_t item = list_items[offset + n];
+        if (item >= header->node_count || (item != 0 && item <= i)) {
+          return false;
+        }
+      }
+    } else if (has_symbol_payload((NodeType)kind[i]) &&
+               (uint32_t)payload[i] >= header->symbol_count) {
+      return false;
+    }
+  }
+
+  const ASTFileSymbol *records =
+      (const ASTFileSymbol *)(base + header->symbols_offset);
+  for (uint32_t i = 0; i < header->symbol_count; i++) {
+    const ASTFileSymbol *record = &records[i];
+    if (!valid_string(header, record->name) ||
+        record->kind >= SYMBOL_KIND_COUNT ||
+        (record->arguments != AST_FILE_NONE &&
+         record->arguments >= header->symbol_count) ||
+        (record->next != AST_FILE_NONE &&
+         record->next >= header->symbol_count) ||
+        record->number_of_arguments < 0) {
+      return false;
+    }
+
+    // func_def_argname() follows the list as far as the argument count
+    uint32_t formal = record->arguments;
+    for (int32_t n = 0; n < record->number_of_arguments; n++) {
+      if (formal == AST_FILE_NONE) {
+        if (record->arguments == AST_FILE_NONE) {
+          break; // a callee such as println has a count but no list
+        }
+        return false;
+      }
+      formal = records[formal].next;
+    }
+  }
+
+  return true;
+}
+
+ASTStore *ast_file_load(const char *path) {
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    fprintf(stderr, "ERROR: could not open AST file %s\n", path);
+    return NULL;
+  }
+
+  struct stat info;
+  if (fstat(fd, &info) != 0 || info.st_size <= 0) {
+    fprintf(stderr, "ERROR: could not read AST file %s\n", path);
+    close(fd);
+    return NULL;
+  }
+
+  size_t size = (size_t)info.st_size;
+  void *mapping = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (mapping == MAP_FAILED) {
+    fprintf(stderr, "ERROR: could not map AST file %s\n", path);
+    return NULL;
+  }
+
+  const unsigned char *base = mapping;
+  if (!valid_file(base, size)) {
+    fprintf(stderr, "ERROR: %s is not a valid AST file\n", path);
+    munmap(mapping, size);
+    return NULL;
+  }
+
+  const ASTFileHeader *header = mapping;
+  ASTStore *store = calloc(1, sizeof(ASTStore));
+  uint32_t symbols = header->symbol_count;
+  Symbol *loaded = calloc(symbols ? symbols : 1, sizeof(Symbol));
+  Symbol **symbol_ptrs = calloc(symbols ? symbols : 1, sizeof(Symbol *));
+  if (!store || !loaded || !symbol_ptrs) {
+    fprintf(stderr, "ERROR: Memory allocation failed\n");
+    exit(1);
+  }
+
+  const ASTFileSymbol *records =
+      (const ASTFileSymbol *)(base + header->symbols_offset);
+  char *strings = (char *)(base + header->strings_offset);
+  for (uint32_t i = 0; i < symbols; i++) {
+    const ASTFileSymbol *record = &records[i];
+    Symbol *symbol = &loaded[i];
+
+    symbol->name = strings + record->name;
+    symbol->kind = (SymbolKind)record->kind;
+    symbol->flags = record->flags;
+    symbol->offset = record->offset;
+    symbol->number_of_arguments = record->number_of_arguments;
+    symbol->local_var_bytes = record->local_var_bytes;
+    symbol->arguments = (record->arguments != AST_FILE_NONE)
+                            ? &loaded[record->arguments]
+                            : NULL;
+    symbol->next =
+        (record->next != AST_FILE_NONE) ? &loaded[record->next] : NULL;
+    symbol->scope = (record->flags & SYMBOL_GLOBAL) ? globalScope
+                                                    : &loaded_local_scope;
+    symbol_ptrs[i] = symbol;
+  }
+
+  // The node arrays are used where they are in the mapping
+  store->node_count = header->node_count;
+  store->kind = (uint8_t *)(base + header->kind_offset);
+  store->child0 = (uint32_t *)(base + header->child0_offset);
+  store->child1 = (uint32_t *)(base + header->child1_offset);
+  store->child2 = (uint32_t *)(base + header->child2_offset);
+  store->payload = (int32_t *)(base + header->payload_offset);
+  store->symbol_count = symbols;
+  store->symbols = symbol_ptrs;
+  store->list_item_count = header->list_item_count;
+  store->list_items = (uint32_t *)(base + header->list_items_offset);
+
+  store->mapping = mapping;
+  store->mapping_size = size;
+  store->loaded_symbols = loaded;
+
+  return store;
+}
@@ -0,0 +1,38 @@
+#ifndef AST_FILE_H
+#define AST_FILE_H
+
+#include "ast_store.h"
+#include <stdbool.h>
+
+/*
+ * On-disk form of a compact store (see ast_store.h), meant to be mapped and
+ * used in place. It holds no pointers: every reference is an index or an
+ * offset from the start of the file, so a file can be mapped at any address.
+ *
+ *   header     magic "CAST", version, counts, and the offset of each section
+ *   kind       node_count bytes
+ *   child0/1/2 node_count uint32 each
+ *   payload    node_count int32; for IDENTIFIER, FUNC_CALL and FUNC_DEF an
+ *              index into the symbol section
+ *   list_items list_item_count uint32
+ *   symbols    symbol_count records: name as an offset into the string
+ *              section, kind, frame offset, argument count, frame size, the
+ *              first formal and next formal as symbol indices, and flags
+ *   strings    NUL-terminated names
+ *
+ * Sections start on 8-byte boundaries. Numbers are in host byte order; the
+ * header records it, and a file from a host with the other order is
+ * rejected.
+ */
+
+// Writes store to path. Returns false, after printing an error, if the file
+// cannot be written.
+bool ast_file_write(const ASTStore *store, const char *path);
+
+// Maps the file at path and returns a store whose node arrays and names point
+// into the mapping. Symbols get fresh Symbol records; global ones are put in
+// globalScope. ast_store_destroy() unmaps the file. Returns NULL, after
+// printing an error, for a file that cannot be read or is not well formed.
+ASTStore *ast_file_load(const char *path);
+
+#endif
@@ -0,0 +1,120 @@
+// ast_stats.c
+#include "ast_stats.h"
+#include <string.h>
+
+static ASTVisitResult count_node(void *node, void *parent, int depth,
+                                 void *context) {
+  (void)parent;
+  ASTStats *stats = context;
+  NodeType ntype = ast_node_type(node);
+
+  stats->node_count[ntype]++;
+  stats->nodes++;
+  stats->depth_sum += (size_t)depth + 1;
+  if (depth + 1 > stats->max_depth) {
+    stats->max_depth = depth + 1;
+  }
+
+  if (ntype == STMT_LIST || ntype == EXPR_LIST) {
+    int length = (ntype == STMT_LIST) ? stmt_list_length(node)
+                                      : expr_list_length(node);
+    stats->lists++;
+    stats->list_items += (size_t)length;
+    if (length > stats->longest_list) {
+      stats->longest_list = length;
+    }
+  }
+
+  return AST_VISIT_CONTINUE;
+}
+
+void ast_stats_collect(void *root, ASTStats *stats) {
+  memset(stats, 0, sizeof(ASTStats));
+  if (root == NULL) {
+    return;
+  }
+
+  ASTVisitor visitor = {count_node, NULL, stats};
+  ast_walk(root, &visitor);
+}
+
+void ast_stats_add(ASTStats *total, const ASTStats *stats) {
+  for (int type = 0; type < AST_NODE_TYPE_COUNT; type++) {
+    total->node_count[type] += stats->node_count[type];
+  }
+  total->nodes += stats->nodes;
+  total->depth_sum += stats->depth_sum;
+  if (stats->max_depth > total->max_depth) {
+    total->max_depth = stats->max_depth;
+  }
+  total->lists += stats->lists;
+  total->list_items += stats->list_items;
+  if (stats->longest_list > total->longest_list) {
+    total->longest_list = stats->longest_list;
+  }
+  total->node_bytes += stats->node_bytes;
+  total->symbol_bytes += stats->symbol_bytes;
+}
+
+static double average_depth(const ASTStats *stats) {
+  return (stats->nodes > 0) ? (double)stats->depth_sum / stats->nodes : 0.0;
+}
+
+static void print_text(const char *name, const ASTStats *stats, FILE *out) {
+  if (name != NULL) {
+    fprintf(out, "ast_stats: %s\n", name);
+  } else {
+    fprintf(out, "ast_stats: program total\n");
+  }
+
+  for (int type = 0; type < AST_NODE_TYPE_COUNT; type++) {
+    if (stats->node_count[type] == 0) {
+      continue;
+    }
+    fprintf(out, "  %-12s %8zu nodes\n", ast_node_type_name(type),
+            stats->node_count[type]);
+  }
+  fprintf(out, "  %-12s %8zu nodes\n", "total", stats->nodes);
+  fprintf(out, "  %-12s %8d max, %.2f average\n", "depth", stats->max_depth,
+          average_depth(stats));
+  fprintf(out, "  %-12s %8zu lists, %zu items, longest %d\n", "lists",
+          stats->lists, stats->list_items, stats->longest_list);
+  fprintf(out, "  %-12s %8zu node bytes, %zu symbol bytes\n", "memory",
+          stats->node_bytes, stats->symbol_bytes);
+}
+
+static void print_json(const char *name, const ASTStats *stats, FILE *out) {
+  // Function names are identifiers, so they need no escaping
+  if (name != NULL) {
+    fprintf(out, "{\"function\":\"%s\",\"nodes\":{", name);
+  } else {
+    fprintf(out, "{\"function\":null,\"nodes\":{");
+  }
+
+  const char *separator = "";
+  for (int type = 0; type < AST_NODE_TYPE_COUNT; type++) {
+    if (stats->node_count[type] == 0) {
+      continue;
+    }
+    fprintf(out, "%s\"%s\":%zu", separator, ast_node_type_name(type),
+            stats->node_count[type]);
+    separator = ",";
+  }
+
+  fprintf(out,
+          "},\"total_nodes\":%zu,\"max_depth\":%d,\"average_depth\":%.2f,"
+          "\"lists\":%zu,\"list_items\":%zu,\"longest_list\":%d,"
+          "\"node_bytes\":%zu,\"symbol_bytes\":%zu}\n",
+          stats->nodes, stats->max_depth, average_depth(stats), stats->lists,
+          stats->list_items, stats->longest_list, stats->node_bytes,
+          stats->symbol_bytes);
+}
+
+void ast_stats_print(const char *name, const ASTStats *stats,
+                     ASTDumpFormat format, FILE *out) {
+  if (format == AST_DUMP_JSON) {
+    print_json(name, stats, out);
+  } else {
+    print_text(name, stats, out);
+  }
+}
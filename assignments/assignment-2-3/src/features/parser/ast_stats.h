@@ -0,0 +1,38 @@
+#ifndef AST_STATS_H
+#define AST_STATS_H
+
+#include "ast.h"
+#include "ast_dump.h"
+#include <stdio.h>
+
+/*
+ * Shape and memory figures for one function's tree, or summed over a
+ * program. Node counts and depths follow the tree as the getters see it, so
+ * a hash-consed node is counted at every place it is used; the byte counts
+ * are what was actually allocated.
+ */
+typedef struct {
+  size_t node_count[AST_NODE_TYPE_COUNT];
+  size_t nodes;        // Sum of node_count
+  int max_depth;       // The root is at depth 1
+  size_t depth_sum;    // Over all nodes, for the average depth
+  size_t lists;        // STMT_LIST and EXPR_LIST nodes
+  size_t list_items;   // Items in those lists
+  int longest_list;
+  size_t node_bytes;   // Arena bytes taken by the nodes and list items
+  size_t symbol_bytes; // Symbol table bytes allocated while parsing
+} ASTStats;
+
+// Fills in everything but the byte counts for the tree below root
+void ast_stats_collect(void *root, ASTStats *stats);
+
+// Adds stats into total
+void ast_stats_add(ASTStats *total, const ASTStats *stats);
+
+// Prints stats for the function called name, or for the whole program when
+// name is NULL. AST_DUMP_JSON prints one object per line; any other format
+// prints a text table.
+void ast_stats_print(const char *name, const ASTStats *stats,
+                     ASTDumpFormat format, FILE *out);
+
+#endif
@@ -0,0 +1,211 @@
+// ast_store.c
+#include "ast_store.h"
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+
+// Store that handles are resolved against; each backend thread binds its own
+static _Thread_local ASTStore *bound_store = NULL;
+
+static void *checked_calloc(size_t count, size_t size) {
+  void *memory = calloc(count, size);
+  if (!memory) {
+    fprintf(stderr, "ERROR: Memory allocation failed\n");
+    exit(1);
+  }
+  return memory;
+}
+
+static bool has_symbol_payload(NodeType node_type) {
+  return node_type == IDENTIFIER || node_type == FUNC_CALL ||
+         node_type == FUNC_DEF;
+}
+
+static bool is_list(NodeType node_type) {
+  return node_type == STMT_LIST || node_type == EXPR_LIST;
+}
+
+typedef struct {
+  uint32_t nodes;
+  uint32_t symbols;
+  uint32_t list_items;
+} TreeSize;
+
+static ASTVisitResult count_node(void *node, void *parent, int depth,
+                                 void *context) {
+  (void)parent;
+  (void)depth;
+  TreeSize *size = context;
+  NodeType node_type = ast_node_type(node);
+
+  size->nodes++;
+  if (has_symbol_payload(node_type)) {
+    size->symbols++;
+  }
+  if (is_list(node_type)) {
+    size->list_items += 1 + ast_node_nchildren(node);
+  }
+
+  return AST_VISIT_CONTINUE;
+}
+
+// Appends node and its subtree in pre-order and returns the node's index
+static uint32_t copy_tree(ASTStore *store, ASTnode *node, uint32_t *next_node) {
+  if (node == NULL) {
+    return 0;
+  }
+
+  uint32_t index = (*next_node)++;
+  store->kind[index] = (uint8_t)node->node_type;
+
+  if (is_list(node->node_type)) {
+    uint32_t offset = store->list_item_count;
+    store->list_item_count += 1 + node->count;
+    store->payload[index] = (int32_t)offset;
+    store->list_items[offset] = (uint32_t)node->count;
+    for (int i = 0; i < node->count; i++) {
+      store->list_items[offset + 1 + i] =
+          copy_tree(store, node->items[i], next_node);
+    }
+    return index;
+  }
+
+  if (node->node_type == INTCONST) {
+    store->payload[index] = node->num;
+  } else if (has_symbol_payload(node->node_type)) {
+    store->payload[index] = (int32_t)store->symbol_count;
+    store->symbols[store->symbol_count++] = node->symbol;
+  }
+
+  store->child0[index] = copy_tree(store, node->child0, next_node);
+  store->child1[index] = copy_tree(store, node->child1, next_node);
+  store->child2[index] = copy_tree(store, node->child2, next_node);
+
+  return index;
+}
+
+ASTStore *ast_store_build(ASTnode *root) {
+  TreeSize size = {1, 0, 0}; // node 0 is reserved
+  const ASTVisitor counter = {count_node, NULL, &size};
+  ast_walk(root, &counter);
+
+  uint32_t nodes = size.nodes;
+  uint32_t symbols = size.symbols;
+  uint32_t list_items = size.list_items;
+
+  ASTStore *store = checked_calloc(1, sizeof(ASTStore));
+  store->node_count = nodes;
+  store->kind = checked_calloc(nodes, sizeof(uint8_t));
+  store->child0 = checked_calloc(nodes, sizeof(uint32_t));
+  store->child1 = checked_calloc(nodes, sizeof(uint32_t));
+  store->child2 = checked_calloc(nodes, sizeof(uint32_t));
+  store->payload = checked_calloc(nodes, sizeof(int32_t));
+  store->symbols = checked_calloc(symbols ? symbols : 1, sizeof(Symbol *));
+  store->list_items =
+      checked_calloc(list_items ? list_items : 1, sizeof(uint32_t));
+
+  store->kind[0] = DUMMY;
+  uint32_t next_node = 1;
+  copy_tree(store, root, &next_node);
+  assert(next_node == nodes);
+
+  return store;
+}
+
+void ast_store_destroy(ASTStore *store) {
+  if (!store) {
+    return;
+  }
+
+  if (store->mapping) {
+    munmap(store->mapping, store->mapping_size);
+    free(store->loaded_symbols);
+    free(store->symbols);
+    free(store);
+    return;
+  }
+
+  free(store->kind);
+  free(store->child0);
+  free(store->child1);
+  free(store->child2);
+  free(store->payload);
+  free(store->symbols);
+  free(store->list_items);
+  free(store);
+}
+
+static void *handle_of(uint32_t index) {
+  if (index == 0) {
+    return NULL;
+  }
+  return (void *)(((uintptr_t)index << 1) | 1);
+}
+
+static uint32_t index_of(const void *handle) {
+  assert(bound_store != NULL);
+  uint32_t index = (uint32_t)((uintptr_t)handle >> 1);
+  assert(index > 0 && index < bound_store->node_count);
+  return index;
+}
+
+void *ast_store_root(const ASTStore *store) {
+  return (store->node_count > 1) ? handle_of(1) : NULL;
+}
+
+ASTStore *ast_store_bind(ASTStore *store) {
+  ASTStore *previous = bound_store;
+  bound_store = store;
+  return previous;
+}
+
+NodeType ast_store_kind(const void *handle) {
+  return (NodeType)bound_store->kind[index_of(handle)];
+}
+
+int ast_store_nchildren(const void *handle) {
+  uint32_t index = index_of(handle);
+  if (is_list((NodeType)bound_store->kind[index])) {
+    return (int)bound_store->list_items[bound_store->payload[index]];
+  }
+  return 3;
+}
+
+void *ast_store_child(const void *handle, int n) {
+  uint32_t index = index_of(handle);
+  if (is_list((NodeType)bound_store->kind[index])) {
+    uint32_t offset = (uint32_t)bound_store->payload[index];
+    assert(n >= 0 && (uint32_t)n < bound_store->list_items[offset]);
+    return handle_of(bound_store->list_items[offset + 1 + n]);
+  }
+  switch (n) {
+  case 0:
+    return handle_of(bound_store->child0[index]);
+  case 1:
+    return handle_of(bound_store->child1[index]);
+  case 2:
+    return handle_of(bound_store->child2[index]);
+  default:
+    return NULL;
+  }
+}
+
+Symbol *ast_store_symbol(const void *handle) {
+  uint32_t index = index_of(handle);
+  if (!has_symbol_payload((NodeType)bound_store->kind[index])) {
+    return NULL;
+  }
+  return bound_store->symbols[bound_store->payload[index]];
+}
+
+int ast_store_num(const void *handle) {
+  return bound_store->payload[index_of(handle)];
+}
+
+size_t ast_store_bytes(const ASTStore *store) {
+  size_t per_node = sizeof(uint8_t) + 3 * sizeof(uint32_t) + sizeof(int32_t);
+  return sizeof(ASTStore) + store->node_count * per_node +
+         store->symbol_count * sizeof(Symbol *) +
+         store->list_item_count * sizeof(uint32_t);
+}
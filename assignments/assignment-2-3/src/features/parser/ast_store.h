@@ -0,0 +1,73 @@
+#ifndef AST_STORE_H
+#define AST_STORE_H
+
+#include "ast.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Compact, read-only copy of a syntax tree. Nodes are numbered in pre-order
+ * and described by parallel arrays instead of being linked by pointers:
+ *
+ *   kind[i]     node type
+ *   child0/1/2  index of each child, 0 when there is none
+ *   payload[i]  the value of an INTCONST, an index into symbols[] for
+ *               IDENTIFIER, FUNC_CALL and FUNC_DEF nodes, or for a
+ *               STMT_LIST or EXPR_LIST the offset in list_items[] of its
+ *               item count, which is followed by the item indices
+ *
+ * Index 0 is reserved so that 0 can mean "no child".
+ *
+ * Nodes of a store are handed to the ast.h getters as tagged handles,
+ * (index << 1) | 1, which can never be confused with a real ASTnode pointer.
+ * The getters resolve a handle against the store bound to the calling thread
+ * with ast_store_bind().
+ */
+typedef struct ASTStore {
+  uint32_t node_count; // including the reserved node 0
+  uint8_t *kind;
+  uint32_t *child0;
+  uint32_t *child1;
+  uint32_t *child2;
+  int32_t *payload;
+
+  uint32_t symbol_count;
+  Symbol **symbols;
+
+  uint32_t list_item_count;
+  uint32_t *list_items;
+
+  // Set for a store loaded by ast_file_load(): the arrays above point into
+  // the mapped file, and the symbols into loaded_symbols
+  void *mapping;
+  size_t mapping_size;
+  Symbol *loaded_symbols;
+} ASTStore;
+
+// Copies the tree rooted at root into a new store
+ASTStore *ast_store_build(ASTnode *root);
+void ast_store_destroy(ASTStore *store);
+
+// Handle for the root of the copied tree (node 1), or NULL for an empty store
+void *ast_store_root(const ASTStore *store);
+
+// Makes store the one that handles are resolved against on this thread and
+// returns the previously bound one
+ASTStore *ast_store_bind(ASTStore *store);
+
+static inline bool ast_store_is_handle(const void *ptr) {
+  return ((uintptr_t)ptr & 1) != 0;
+}
+
+// Accessors used by the getters in ast.c; handle must not be NULL
+NodeType ast_store_kind(const void *handle);
+int ast_store_nchildren(const void *handle);
+void *ast_store_child(const void *handle, int n);
+Symbol *ast_store_symbol(const void *handle);
+int ast_store_num(const void *handle);
+
+// Bytes taken by the arrays of a store
+size_t ast_store_bytes(const ASTStore *store);
+
+#endif
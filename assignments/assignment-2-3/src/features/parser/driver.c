@@ -6,14 +6,33 @@
  *          generation is carried out.
  */
 
+#include "ast_dump.h"
+#include "ast_file.h"
+#include "interp.h"
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
 extern int parse();
 
 int chk_decl_flag = 0;  /* set to 1 to do semantic checking */
 int print_ast_flag = 0; /* set to 1 to print out the AST */
 int gen_code_flag = 0;  /* set to 1 to generate code */
+int pipeline_flag = 0;  /* set to 1 to generate code on a second thread */
+int compact_ast_flag = 0; /* set to 1 to keep ASTs in the compact store */
+int stream_flag = 0;      /* set to 1 to emit code function by function */
+int fold_flag = 0;        /* set to 1 to fold constants before codegen */
+int hash_cons_flag = 0;   /* set to 1 to share identical expression nodes */
+int run_flag = 0;         /* set to 1 to interpret the program */
+int ast_stats_flag = 0;   /* set to 1 to report the shape of each AST */
+int inline_flag = 0;      /* set to 1 to inline calls to small functions */
+char *save_ast_dir = NULL;  /* directory to write each function's AST to */
+char *load_ast_path = NULL; /* AST file to print instead of parsing */
+char *export_sym_path = NULL;  /* file to write the global symbols to */
+char **import_sym_paths = NULL; /* files whose symbols are declared first */
+int import_sym_count = 0;
+ASTDumpFormat ast_format = AST_DUMP_TEXT; /* how --print_ast prints */
 
 /*
  * parse_args() -- parse command-line arguments and set flags appropriately
@@ -22,6 +41,38 @@ int gen_code_flag = 0;  /* set to 1 to generate code */
  *    --chk_decl     : to check legality of declarations
  *    --print_ast    : to print out the AST of each function
  *    --gen_code     : to generate code
+ *    --pipeline     : to generate code for each function on a backend
+ *                     thread while the next function is being parsed
+ *    --compact_ast  : to copy each function's AST into the index-based
+ *                     store before printing it or generating code
+ *    --stream       : to print each function's code as soon as it is parsed
+ *                     and free it, instead of holding the whole program
+ *                     (--pipeline takes precedence)
+ *    --fold         : to fold constant conditions, replace calls with
+ *                     constant arguments to pure functions defined earlier
+ *                     with their value, and drop branches that can never run
+ *                     before generating code
+ *    --hash_cons    : to build a single node for structurally identical
+ *                     expressions without calls within each function
+ *    --inline       : to replace calls to small functions defined earlier
+ *                     with a copy of their body before generating code
+ *    --save_ast=DIR : to write each function's AST to DIR/<name>.ast in the
+ *                     binary format of ast_file.h
+ *    --load_ast=FILE: to print the AST stored in FILE and exit, without
+ *                     reading a program
+ *    --ast_format=F : to print ASTs as F, one of text (the default), json
+ *                     or sexpr
+ *    --run          : to run the program's main() in the AST interpreter
+ *                     after parsing and report how many statements ran
+ *                     (code is then generated in one batch)
+ *    --ast_stats    : to report node counts by type, depth, list lengths
+ *                     and memory for each function and the whole program
+ *                     on stderr, as text or as JSON with --ast_format=json
+ *    --export_sym=FILE: to write the global variables and the functions with
+ *                     their arities to FILE in the format of sym_file.h
+ *    --import_sym=FILE: to declare the globals exported to FILE by another
+ *                     translation unit before parsing, so calls to its
+ *                     functions are checked; may be given more than once
  */
 void parse_args(int argc, char *argv[]) {
   int i;
@@ -33,6 +84,41 @@ void parse_args(int argc, char *argv[]) {
         print_ast_flag = 1;
       } else if (strcmp(argv[i], "--gen_code") == 0) {
         gen_code_flag = 1;
+      } else if (strcmp(argv[i], "--pipeline") == 0) {
+        pipeline_flag = 1;
+      } else if (strcmp(argv[i], "--compact_ast") == 0) {
+        compact_ast_flag = 1;
+      } else if (strcmp(argv[i], "--stream") == 0) {
+        stream_flag = 1;
+      } else if (strcmp(argv[i], "--fold") == 0) {
+        fold_flag = 1;
+      } else if (strcmp(argv[i], "--hash_cons") == 0) {
+        hash_cons_flag = 1;
+      } else if (strcmp(argv[i], "--run") == 0) {
+        run_flag = 1;
+      } else if (strcmp(argv[i], "--ast_stats") == 0) {
+        ast_stats_flag = 1;
+      } else if (strcmp(argv[i], "--inline") == 0) {
+        inline_flag = 1;
+      } else if (strncmp(argv[i], "--save_ast=", 11) == 0) {
+        save_ast_dir = argv[i] + 11;
+      } else if (strncmp(argv[i], "--load_ast=", 11) == 0) {
+        load_ast_path = argv[i] + 11;
+      } else if (strncmp(argv[i], "--export_sym=", 13) == 0) {
+        export_sym_path = argv[i] + 13;
+      } else if (strncmp(argv[i], "--import_sym=", 13) == 0) {
+        if (import_sym_paths == NULL) {
+          import_sym_paths = malloc(argc * sizeof(char *));
+          if (!import_sym_paths) {
+            fprintf(stderr, "ERROR: Memory allocation failed\n");
+            exit(1);
+          }
+        }
+        import_sym_paths[import_sym_count++] = argv[i] + 13;
+      } else if (strncmp(argv[i], "--ast_format=", 13) == 0) {
+        if (!ast_dump_format_from_name(argv[i] + 13, &ast_format)) {
+          fprintf(stderr, "Unrecognized AST format: %s\n", argv[i] + 13);
+        }
       } else {
         fprintf(stderr, "Unrecognized option: %s\n", argv[i]);
       }
@@ -40,12 +126,53 @@ void parse_args(int argc, char *argv[]) {
   }
 }
 
+/*
+ * print_ast_file() -- print the AST saved in the file at path
+ */
+static int print_ast_file(const char *path) {
+  ASTStore *store = ast_file_load(path);
+  if (store == NULL) {
+    return 1;
+  }
+
+  ASTDumper *dumper = ast_dumper_create(STDOUT_FILENO, ast_format);
+  ASTStore *previous_store = ast_store_bind(store);
+  ast_dump(dumper, ast_store_root(store));
+  ast_store_bind(previous_store);
+  ast_dumper_destroy(dumper);
+
+  ast_store_destroy(store);
+  return 0;
+}
+
+/*
+ * run_program() -- interpret the parsed program, starting at main()
+ */
+static int run_program(void) {
+  unsigned long statements = 0;
+  bool ran = interp_run(stdout, &statements);
+  interp_reset();
+  if (!ran) {
+    return 1;
+  }
+
+  fprintf(stderr, "executed %lu statements\n", statements);
+  return 0;
+}
+
 int main(int argc, char *argv[]) {
   int error_code;
 
   parse_args(argc, argv);
 
+  if (load_ast_path != NULL) {
+    return print_ast_file(load_ast_path);
+  }
+
   error_code = parse();
+  if (error_code == 0 && run_flag) {
+    error_code = run_program();
+  }
 
   return error_code;
 }
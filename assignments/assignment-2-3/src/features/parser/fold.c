@@ -0,0 +1,172 @@
+// fold.c
+#include "fold.h"
+
+// && and || keep their short-circuit order: an operand with a known value is
+// only dropped if that cannot skip or repeat a call
+static ASTnode *fold_logic(ASTnode *node) {
+  ASTnode *lhs = node->child0;
+  ASTnode *rhs = node->child1;
+  int lhs_value = fold_condition_value(lhs);
+  int rhs_value = fold_condition_value(rhs);
+
+  switch (node->node_type) {
+  case AND:
+    if (lhs_value == 0) {
+      return lhs;
+    }
+    if (lhs_value == 1) {
+      return rhs;
+    }
+    if (rhs_value == 1) {
+      return lhs;
+    }
+    if (rhs_value == 0 && !ast_contains_call(lhs)) {
+      return rhs;
+    }
+    break;
+  case OR:
+    if (lhs_value == 1) {
+      return lhs;
+    }
+    if (lhs_value == 0) {
+      return rhs;
+    }
+    if (rhs_value == 0) {
+      return lhs;
+    }
+    if (rhs_value == 1 && !ast_contains_call(lhs)) {
+      return rhs;
+    }
+    break;
+  case NOT:
+    if (lhs != NULL && lhs->node_type == NOT) {
+      return lhs->child0;
+    }
+    break;
+  default:
+    break;
+  }
+
+  return node;
+}
+
+ASTnode *fold_constants(ASTnode *node) {
+  if (node == NULL) {
+    return NULL;
+  }
+
+  if (node->node_type == STMT_LIST || node->node_type == EXPR_LIST) {
+    // A statement that folds away stays as an empty (NULL) item
+    for (int i = 0; i < node->count; i++) {
+      node->items[i] = fold_constants(node->items[i]);
+    }
+    return node;
+  }
+
+  node->child0 = fold_constants(node->child0);
+  node->child1 = fold_constants(node->child1);
+  node->child2 = fold_constants(node->child2);
+
+  switch (node->node_type) {
+  case AND:
+  case OR:
+  case NOT:
+    return fold_logic(node);
+  case IF:
+    switch (fold_condition_value(node->child0)) {
+    case 1:
+      return node->child1;
+    case 0:
+      return node->child2;
+    default:
+      return node;
+    }
+  case WHILE:
+    // A loop that runs forever still needs its test, which is a plain jump
+    return (fold_condition_value(node->child0) == 0) ? NULL : node;
+  default:
+    return node;
+  }
+}
+
+static int compare_constants(NodeType node_type, int lhs, int rhs) {
+  switch (node_type) {
+  case EQ:
+    return lhs == rhs;
+  case NE:
+    return lhs != rhs;
+  case LT:
+    return lhs < rhs;
+  case LE:
+    return lhs <= rhs;
+  case GT:
+    return lhs > rhs;
+  case GE:
+    return lhs >= rhs;
+  default:
+    return -1;
+  }
+}
+
+int fold_condition_value(void *node) {
+  if (node == NULL) {
+    return -1;
+  }
+
+  NodeType node_type = ast_node_type(node);
+  void *lhs = NULL;
+  void *rhs = NULL;
+  int lhs_value = -1;
+
+  switch (node_type) {
+  case EQ:
+  case NE:
+  case LT:
+  case LE:
+  case GT:
+  case GE:
+    lhs = expr_operand_1(node);
+    rhs = expr_operand_2(node);
+    if (ast_node_type(lhs) == INTCONST && ast_node_type(rhs) == INTCONST) {
+      return compare_constants(node_type, expr_intconst_val(lhs),
+                               expr_intconst_val(rhs));
+    }
+    // A variable compared with itself
+    if (ast_node_type(lhs) == IDENTIFIER && ast_node_type(rhs) == IDENTIFIER &&
+        ast_node_symbol(lhs) == ast_node_symbol(rhs)) {
+      return compare_constants(node_type, 0, 0);
+    }
+    return -1;
+
+  case NOT:
+    lhs_value = fold_condition_value(expr_operand_1(node));
+    return (lhs_value < 0) ? -1 : !lhs_value;
+
+  case AND:
+    lhs = expr_operand_1(node);
+    lhs_value = fold_condition_value(lhs);
+    if (lhs_value >= 0) {
+      return (lhs_value == 0) ? 0 : fold_condition_value(expr_operand_2(node));
+    }
+    if (fold_condition_value(expr_operand_2(node)) == 0 &&
+        !ast_contains_call(lhs)) {
+      return 0;
+    }
+    return -1;
+
+  case OR:
+    lhs = expr_operand_1(node);
+    lhs_value = fold_condition_value(lhs);
+    if (lhs_value >= 0) {
+      return (lhs_value == 1) ? 1 : fold_condition_value(expr_operand_2(node));
+    }
+    if (fold_condition_value(expr_operand_2(node)) == 1 &&
+        !ast_contains_call(lhs)) {
+      return 1;
+    }
+    return -1;
+
+  default:
+    return -1;
+  }
+}
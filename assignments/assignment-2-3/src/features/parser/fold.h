@@ -0,0 +1,19 @@
+#ifndef FOLD_H
+#define FOLD_H
+
+#include "ast.h"
+
+// Simplifies the tree below node before it is lowered: && || and ! drop the
+// operands whose value is known, conditions whose outcome is known are
+// dropped together with the branch they make dead, and while loops that
+// never run are removed.
+// Nodes are rewritten in place; new ones come from the current arena. Returns
+// the node that replaces node, which is NULL when a statement disappears.
+ASTnode *fold_constants(ASTnode *node);
+
+// Returns 1 or 0 when the boolean expression at node always has that value
+// and can be skipped without losing a call, -1 otherwise. Works on any AST
+// pointer the getters accept.
+int fold_condition_value(void *node);
+
+#endif
@@ -0,0 +1,348 @@
+// inline.c
+#include "inline.h"
+#include "tac.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Cost of the call sequence generate_mips() emits, in instructions. A node of
+// the callee's body is counted as about one instruction.
+#define INLINE_CALL_COST 12 // jal, prologue, epilogue and popping the args
+#define INLINE_ARG_COST 2   // computing and pushing one argument
+// A call in a loop runs many times, so a bigger body still pays off there
+#define INLINE_LOOP_FACTOR 4
+// Most nodes that inlining may add to one function
+#define INLINE_GROWTH_LIMIT 400
+
+typedef struct {
+  Symbol *function;
+  ASTnode *body;   // The statements before the final return, or NULL
+  ASTnode *result; // The value of the final return, or NULL
+  int size;        // Nodes in body and result
+} Candidate;
+
+static Candidate *candidates = NULL;
+static int candidate_count = 0;
+static int candidate_capacity = 0;
+
+// From function symbol to index in candidates
+static SymbolIndex candidate_table = {0};
+
+// Holds the copies of the candidates' bodies
+static ASTArena *candidate_arena = NULL;
+
+// Scope of the locals made for inlined code. They are never looked up by
+// name, so it stays empty.
+static Scope inline_scope = {NULL, NULL, 0};
+
+// The function whose calls are being inlined, the nodes added to it so far,
+// and the locals made for it, keyed by name
+static Symbol *caller = NULL;
+static int caller_growth = 0;
+static Symbol **caller_locals = NULL;
+static int caller_local_count = 0;
+static int caller_local_capacity = 0;
+
+/*******************************************************************************
+ *                                                                             *
+ *                                  COPYING                                    *
+ *                                                                             *
+ *******************************************************************************/
+
+// A new local at the bottom of the caller's frame
+static Symbol *new_caller_local(const char *name) {
+  Symbol *symbol = create_symbol(name);
+  symbol->kind = SYMBOL_VARIABLE;
+  symbol->flags = SYMBOL_LOCAL;
+  symbol->scope = &inline_scope;
+  symbol->offset = new_frame_slot(caller);
+  return symbol;
+}
+
+// Functions and globals are shared with the callee. A parameter or local of
+// the callee is replaced by the caller's local <name>@<callee>. Every inlined
+// copy of a callee in one caller uses the same locals, since the copies never
+// run at the same time.
+static Symbol *rename_symbol(Symbol *symbol, void *context) {
+  const Candidate *callee = context;
+  if (symbol->flags & SYMBOL_GLOBAL) {
+    return symbol;
+  }
+
+  size_t size = strlen(symbol->name) + strlen(callee->function->name) + 2;
+  char *name = malloc(size);
+  if (!name) {
+    fprintf(stderr, "ERROR: Memory allocation failed\n");
+    exit(1);
+  }
+  snprintf(name, size, "%s@%s", symbol->name, callee->function->name);
+
+  for (int i = 0; i < caller_local_count; i++) {
+    if (strcmp(caller_locals[i]->name, name) == 0) {
+      free(name);
+      return caller_locals[i];
+    }
+  }
+
+  if (caller_local_count == caller_local_capacity) {
+    caller_local_capacity =
+        (caller_local_capacity == 0) ? 8 : caller_local_capacity * 2;
+    caller_locals = checked_realloc(caller_locals,
+                                    caller_local_capacity * sizeof(Symbol *));
+  }
+  Symbol *local = new_caller_local(name);
+  caller_locals[caller_local_count++] = local;
+  free(name);
+  return local;
+}
+
+// Counts the nodes below node into *size. Returns false if the tree has a
+// return or a call to function itself.
+static bool can_inline(ASTnode *node, const Symbol *function, int *size) {
+  if (node == NULL) {
+    return true;
+  }
+  (*size)++;
+
+  if (node->node_type == RETURN ||
+      (node->node_type == FUNC_CALL && node->symbol == function)) {
+    return false;
+  }
+
+  if (node->node_type == STMT_LIST || node->node_type == EXPR_LIST) {
+    for (int i = 0; i < node->count; i++) {
+      if (!can_inline(node->items[i], function, size)) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  return can_inline(node->child0, function, size) &&
+         can_inline(node->child1, function, size) &&
+         can_inline(node->child2, function, size);
+}
+
+/*******************************************************************************
+ *                                                                             *
+ *                                 CANDIDATES                                  *
+ *                                                                             *
+ *******************************************************************************/
+
+static const Candidate *find_candidate(const Symbol *function) {
+  int index = symbol_index_get(&candidate_table, function);
+  return (index >= 0) ? &candidates[index] : NULL;
+}
+
+// What a call with nargs arguments costs beyond the callee's body
+static int call_cost(int nargs) {
+  return INLINE_CALL_COST + nargs * INLINE_ARG_COST;
+}
+
+void inline_register(ASTnode *func_def) {
+  Symbol *function = func_def->symbol;
+  ASTnode *body = func_def->child0;
+  if (body != NULL && body->node_type != STMT_LIST) {
+    return;
+  }
+
+  // Only a return at the very end can be inlined, as the value of the call
+  int nstmts = (body != NULL) ? body->count : 0;
+  ASTnode *last = (nstmts > 0) ? body->items[nstmts - 1] : NULL;
+  bool returns = (last != NULL && last->node_type == RETURN);
+  if (returns) {
+    nstmts--;
+  }
+
+  int size = 0;
+  for (int i = 0; i < nstmts; i++) {
+    if (!can_inline(body->items[i], function, &size)) {
+      return;
+    }
+  }
+  if (returns && !can_inline(last->child0, function, &size)) {
+    return;
+  }
+  if (size > call_cost(function->number_of_arguments) * INLINE_LOOP_FACTOR) {
+    return;
+  }
+
+  if (candidate_arena == NULL) {
+    candidate_arena = ast_arena_create();
+  }
+  if (candidate_count == candidate_capacity) {
+    candidate_capacity =
+        (candidate_capacity == 0) ? 16 : candidate_capacity * 2;
+    candidates =
+        checked_realloc(candidates, candidate_capacity * sizeof(Candidate));
+  }
+
+  Candidate *candidate = &candidates[candidate_count];
+  candidate->function = function;
+  candidate->size = size;
+
+  ASTArena *previous_arena = ast_arena_use(candidate_arena);
+  candidate->body = NULL;
+  if (nstmts > 0) {
+    ASTnode **items = malloc(nstmts * sizeof(ASTnode *));
+    if (!items) {
+      fprintf(stderr, "ERROR: Memory allocation failed\n");
+      exit(1);
+    }
+    for (int i = 0; i < nstmts; i++) {
+      items[i] = ast_copy(body->items[i], ast_keep_symbol, NULL);
+    }
+    candidate->body = create_stmt_list_node(items, nstmts);
+    free(items);
+  }
+  candidate->result =
+      returns ? ast_copy(last->child0, ast_keep_symbol, NULL) : NULL;
+  ast_arena_use(previous_arena);
+
+  symbol_index_put(&candidate_table, function, candidate_count);
+  candidate_count++;
+}
+
+void inline_reset(void) {
+  ast_arena_destroy(candidate_arena);
+  candidate_arena = NULL;
+  free(candidates);
+  candidates = NULL;
+  candidate_count = 0;
+  candidate_capacity = 0;
+  symbol_index_free(&candidate_table);
+  free(caller_locals);
+  caller_locals = NULL;
+  caller_local_count = 0;
+  caller_local_capacity = 0;
+}
+
+/*******************************************************************************
+ *                                                                             *
+ *                                 CALL SITES                                  *
+ *                                                                             *
+ *******************************************************************************/
+
+// Returns the candidate to inline for call, or NULL if the call stays
+static const Candidate *choose_candidate(ASTnode *call, bool in_loop,
+                                         bool value_used) {
+  const Candidate *candidate = find_candidate(call->symbol);
+  if (candidate == NULL || candidate->function == caller) {
+    return NULL;
+  }
+
+  int nargs = (call->child0 != NULL) ? call->child0->count : 0;
+  if (nargs != candidate->function->number_of_arguments) {
+    return NULL;
+  }
+  if (value_used && candidate->result == NULL) {
+    return NULL;
+  }
+
+  int limit = call_cost(nargs) * (in_loop ? INLINE_LOOP_FACTOR : 1);
+  if (candidate->size > limit ||
+      caller_growth + candidate->size > INLINE_GROWTH_LIMIT) {
+    return NULL;
+  }
+  return candidate;
+}
+
+// The block that replaces call. The arguments are assigned to the callee's
+// parameters, the body runs, and then the value of the final return goes to
+// use: assigned to target for ASSG, returned for RETURN, and for FUNC_CALL,
+// where the value is unused, kept only if it is itself a call.
+static ASTnode *expand_call(ASTnode *call, const Candidate *candidate,
+                            NodeType use, ASTnode *target) {
+  int nargs = (call->child0 != NULL) ? call->child0->count : 0;
+  ASTnode **items = malloc((nargs + 2) * sizeof(ASTnode *));
+  if (!items) {
+    fprintf(stderr, "ERROR: Memory allocation failed\n");
+    exit(1);
+  }
+
+  // The arguments are assigned right to left, the order a call evaluates them
+  // in (see ast_right_operand_first())
+  Symbol *formal = candidate->function->arguments;
+  for (int i = 0; i < nargs; i++, formal = formal->next) {
+    ASTnode *parameter =
+        create_identifier_node(rename_symbol(formal, (void *)candidate));
+    items[nargs - 1 - i] = create_assg_node(parameter, call->child0->items[i]);
+  }
+  int count = nargs;
+
+  if (candidate->body != NULL) {
+    items[count++] =
+        ast_copy(candidate->body, rename_symbol, (void *)candidate);
+  }
+
+  ASTnode *result =
+      ast_copy(candidate->result, rename_symbol, (void *)candidate);
+  if (use == ASSG) {
+    items[count++] = create_assg_node(target, result);
+  } else if (use == RETURN) {
+    items[count++] = create_return_node(result);
+  } else if (result != NULL && result->node_type == FUNC_CALL) {
+    items[count++] = result;
+  }
+
+  ASTnode *block = create_stmt_list_node(items, count);
+  free(items);
+  caller_growth += candidate->size;
+  return block;
+}
+
+// Returns the statement that replaces stmt
+static ASTnode *inline_statement(ASTnode *stmt, bool in_loop) {
+  if (stmt == NULL) {
+    return NULL;
+  }
+
+  const Candidate *candidate = NULL;
+
+  switch (stmt->node_type) {
+  case STMT_LIST:
+    for (int i = 0; i < stmt->count; i++) {
+      stmt->items[i] = inline_statement(stmt->items[i], in_loop);
+    }
+    return stmt;
+
+  case IF:
+    stmt->child1 = inline_statement(stmt->child1, in_loop);
+    stmt->child2 = inline_statement(stmt->child2, in_loop);
+    return stmt;
+
+  case WHILE:
+    stmt->child1 = inline_statement(stmt->child1, true);
+    return stmt;
+
+  case FUNC_CALL:
+    candidate = choose_candidate(stmt, in_loop, false);
+    return candidate ? expand_call(stmt, candidate, FUNC_CALL, NULL) : stmt;
+
+  case ASSG:
+    if (stmt->child1 != NULL && stmt->child1->node_type == FUNC_CALL) {
+      candidate = choose_candidate(stmt->child1, in_loop, true);
+    }
+    return candidate ? expand_call(stmt->child1, candidate, ASSG, stmt->child0)
+                     : stmt;
+
+  case RETURN:
+    if (stmt->child0 != NULL && stmt->child0->node_type == FUNC_CALL) {
+      candidate = choose_candidate(stmt->child0, in_loop, true);
+    }
+    return candidate ? expand_call(stmt->child0, candidate, RETURN, NULL)
+                     : stmt;
+
+  default:
+    return stmt;
+  }
+}
+
+void inline_calls(ASTnode *func_def) {
+  caller = func_def->symbol;
+  caller_growth = 0;
+  caller_local_count = 0;
+
+  func_def->child0 = inline_statement(func_def->child0, false);
+
+  caller = NULL;
+}
@@ -0,0 +1,30 @@
+#ifndef INLINE_H
+#define INLINE_H
+
+#include "ast.h"
+
+// Replaces calls to small functions with a copy of the callee's body. A
+// function can be inlined once inline_register() has seen it, if its body
+// only returns in its last statement, it does not call itself, and it is
+// small next to what a call costs: pushing the arguments, jal, the prologue
+// and epilogue, and popping the arguments. Calls in loops may take bigger
+// callees.
+//
+// Calls are inlined where they are a statement of their own, the right-hand
+// side of an assignment, or the value of a return. The callee's parameters
+// and locals become locals of the caller named <name>@<callee>, so the
+// caller's local_var_bytes grows. Arguments are assigned to them right to
+// left before the body runs, the order a call evaluates them in.
+
+// Inlines calls in the body of func_def, which must be in the current arena
+void inline_calls(ASTnode *func_def);
+
+// Makes func_def a candidate for inlining into the functions that follow.
+// The body and its locals are copied, so func_def's arena and symbol arena
+// may be released afterwards.
+void inline_register(ASTnode *func_def);
+
+// Forgets all candidates
+void inline_reset(void);
+
+#endif
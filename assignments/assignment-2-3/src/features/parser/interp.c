@@ -0,0 +1,356 @@
+// interp.c
+#include "interp.h"
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Each interpreted call also nests a few C calls, so recursion in the program
+// is bounded well below what the C stack can hold
+#define INTERP_MAX_CALL_DEPTH 10000
+
+typedef struct {
+  Symbol *symbol;
+  void *func_def;
+  ASTArena *arena;
+  ASTStore *store;
+  ASTArena *symbol_arena;
+  int nargs;
+  int nlocals;
+  int nslots; // Parameters first, then the locals
+} InterpFunction;
+
+typedef struct {
+  const InterpFunction *function;
+  size_t base; // Index of the frame's first slot on the value stack
+} Frame;
+
+static InterpFunction *functions = NULL;
+static int function_count = 0;
+static int function_capacity = 0;
+
+// From function symbol to index in functions
+static SymbolIndex function_table = {0};
+
+// Frames of the calls in progress. Slots are addressed by index, since the
+// stack moves when it grows.
+static int *stack = NULL;
+static size_t stack_top = 0;
+static size_t stack_capacity = 0;
+
+static FILE *output = NULL;
+static unsigned long statement_count = 0;
+static int call_depth = 0;
+static int return_value = 0;
+
+/*******************************************************************************
+ *                                                                             *
+ *                                  FUNCTIONS                                  *
+ *                                                                             *
+ *******************************************************************************/
+
+static const InterpFunction *find_function(const Symbol *symbol) {
+  int index = symbol_index_get(&function_table, symbol);
+  return (index >= 0) ? &functions[index] : NULL;
+}
+
+void interp_add_function(void *func_def, ASTArena *arena, ASTStore *store,
+                         ASTArena *symbol_arena) {
+  if (function_count == function_capacity) {
+    function_capacity = (function_capacity == 0) ? 16 : function_capacity * 2;
+    functions = checked_realloc(functions,
+                                function_capacity * sizeof(InterpFunction));
+  }
+
+  ASTStore *previous_store = ast_store_bind(store);
+  InterpFunction *function = &functions[function_count];
+  function->symbol = ast_node_symbol(func_def);
+  function->func_def = func_def;
+  function->arena = arena;
+  function->store = store;
+  function->symbol_arena = symbol_arena;
+  function->nargs = func_def_nargs(func_def);
+  ast_store_bind(previous_store);
+
+  // Locals start at -8($fp); local_var_bytes covers them and one more word
+  int local_bytes = function->symbol->local_var_bytes;
+  function->nlocals = (local_bytes > 4) ? (local_bytes - 4) / 4 : 0;
+  function->nslots = function->nargs + function->nlocals;
+
+  symbol_index_put(&function_table, function->symbol, function_count);
+  function_count++;
+}
+
+void interp_reset(void) {
+  for (int i = 0; i < function_count; i++) {
+    ast_arena_destroy(functions[i].arena);
+    ast_store_destroy(functions[i].store);
+    ast_arena_destroy(functions[i].symbol_arena);
+  }
+  free(functions);
+  symbol_index_free(&function_table);
+  free(stack);
+  functions = NULL;
+  function_count = 0;
+  function_capacity = 0;
+  stack = NULL;
+  stack_top = 0;
+  stack_capacity = 0;
+}
+
+/*******************************************************************************
+ *                                                                             *
+ *                                  EXECUTION                                  *
+ *                                                                             *
+ *******************************************************************************/
+
+static int eval(void *expr, const Frame *frame);
+static bool exec(void *stmt, const Frame *frame);
+
+static void runtime_error(const char *message, const char *name) {
+  fflush(output);
+  fprintf(stderr, "ERROR: %s%s\n", message, name);
+  exit(1);
+}
+
+// Globals keep their value in their symbol; parameters and locals live in
+// the frame. The pointer is only good until the stack next grows.
+static int *variable_slot(Symbol *symbol, const Frame *frame) {
+  if (symbol->flags & SYMBOL_GLOBAL) {
+    return &symbol->value;
+  }
+
+  const InterpFunction *function = frame->function;
+  int index;
+  if (symbol->offset > 0) {
+    index = (symbol->offset - 8) / 4;
+    if (index >= function->nargs) {
+      runtime_error("no parameter slot for ", symbol->name);
+    }
+  } else {
+    int k = (-symbol->offset - 8) / 4;
+    if (k < 0 || k >= function->nlocals) {
+      runtime_error("no local slot for ", symbol->name);
+    }
+    index = function->nargs + k;
+  }
+  return &stack[frame->base + index];
+}
+
+static int call(void *call_node, const Frame *frame) {
+  Symbol *callee_symbol = ast_node_symbol(call_node);
+  void *args = func_call_args(call_node);
+  int nargs = (args != NULL) ? expr_list_length(args) : 0;
+
+  const InterpFunction *callee = find_function(callee_symbol);
+  if (callee == NULL) {
+    if (strcmp(callee_symbol->name, "println") == 0 && nargs == 1) {
+      int value = eval(expr_list_nth(args, 1), frame);
+      fprintf(output, "%d\n", value);
+      return 0;
+    }
+    runtime_error("no definition for called function ", callee_symbol->name);
+  }
+  if (nargs != callee->nargs) {
+    runtime_error("wrong number of arguments to ", callee_symbol->name);
+  }
+  if (call_depth == INTERP_MAX_CALL_DEPTH) {
+    runtime_error("calls nested too deeply in ", callee_symbol->name);
+  }
+
+  size_t base = stack_top;
+  if (base + callee->nslots > stack_capacity) {
+    stack_capacity = (base + callee->nslots) * 2;
+    stack = checked_realloc(stack, stack_capacity * sizeof(int));
+  }
+  memset(&stack[base], 0, callee->nslots * sizeof(int));
+  stack_top = base + callee->nslots;
+
+  // Arguments are evaluated right to left in the caller's tree, as the
+  // generated code pushes them; a call among them puts its frame above this one
+  for (int i = nargs - 1; i >= 0; i--) {
+    int value = eval(expr_list_nth(args, i + 1), frame);
+    stack[base + i] = value;
+  }
+
+  Frame callee_frame = {callee, base};
+  ASTStore *previous_store = ast_store_bind(callee->store);
+  call_depth++;
+  return_value = 0;
+  exec(func_def_body(callee->func_def), &callee_frame);
+  int result = return_value;
+  call_depth--;
+  ast_store_bind(previous_store);
+
+  stack_top = base;
+  return result;
+}
+
+static int eval(void *expr, const Frame *frame) {
+  NodeType ntype = ast_node_type(expr);
+
+  switch (ntype) {
+  case INTCONST:
+    return expr_intconst_val(expr);
+
+  case IDENTIFIER:
+    return *variable_slot(ast_node_symbol(expr), frame);
+
+  case FUNC_CALL:
+    return call(expr, frame);
+
+  case UMINUS:
+    return (int)(0u - (unsigned)eval(expr_operand_1(expr), frame));
+
+  case NOT:
+    return !eval(expr_operand_1(expr), frame);
+
+  case AND:
+    return eval(expr_operand_1(expr), frame) &&
+           eval(expr_operand_2(expr), frame);
+
+  case OR:
+    return eval(expr_operand_1(expr), frame) ||
+           eval(expr_operand_2(expr), frame);
+
+  default:
+    break;
+  }
+
+  // Binary operators, in the order of ast_right_operand_first()
+  int left;
+  int right;
+  if (ast_right_operand_first(expr)) {
+    right = eval(expr_operand_2(expr), frame);
+    left = eval(expr_operand_1(expr), frame);
+  } else {
+    left = eval(expr_operand_1(expr), frame);
+    right = eval(expr_operand_2(expr), frame);
+  }
+
+  switch (ntype) {
+  case ADD:
+    return (int)((unsigned)left + (unsigned)right);
+  case SUB:
+    return (int)((unsigned)left - (unsigned)right);
+  case MUL:
+    return (int)((unsigned)left * (unsigned)right);
+  case DIV:
+    if (right == 0) {
+      runtime_error("division by zero", "");
+    }
+    return (left == INT_MIN && right == -1) ? INT_MIN : left / right;
+  case EQ:
+    return left == right;
+  case NE:
+    return left != right;
+  case LE:
+    return left <= right;
+  case LT:
+    return left < right;
+  case GE:
+    return left >= right;
+  case GT:
+    return left > right;
+  default:
+    runtime_error("cannot evaluate a node of type ", ast_node_type_name(ntype));
+    return 0;
+  }
+}
+
+// Returns true once a return statement has run
+static bool exec(void *stmt, const Frame *frame) {
+  if (stmt == NULL) {
+    return false;
+  }
+
+  NodeType ntype = ast_node_type(stmt);
+  if (ntype == STMT_LIST) {
+    int nstmts = stmt_list_length(stmt);
+    for (int i = 1; i <= nstmts; i++) {
+      if (exec(stmt_list_nth(stmt, i), frame)) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  statement_count++;
+
+  switch (ntype) {
+  case ASSG: {
+    int value = eval(stmt_assg_rhs(stmt), frame);
+    *variable_slot(ast_node_symbol(ast_node_child(stmt, 0)), frame) = value;
+    return false;
+  }
+
+  case FUNC_CALL:
+    call(stmt, frame);
+    return false;
+
+  case IF:
+    if (eval(stmt_if_expr(stmt), frame)) {
+      return exec(stmt_if_then(stmt), frame);
+    }
+    return exec(stmt_if_else(stmt), frame);
+
+  case WHILE:
+    while (eval(stmt_while_expr(stmt), frame)) {
+      if (exec(stmt_while_body(stmt), frame)) {
+        return true;
+      }
+    }
+    return false;
+
+  case RETURN: {
+    void *expr = stmt_return_expr(stmt);
+    return_value = (expr != NULL) ? eval(expr, frame) : 0;
+    return true;
+  }
+
+  default:
+    runtime_error("cannot execute a node of type ", ast_node_type_name(ntype));
+    return false;
+  }
+}
+
+bool interp_run(FILE *out, unsigned long *statements) {
+  const InterpFunction *main_function = NULL;
+  for (int i = 0; i < function_count; i++) {
+    if (strcmp(functions[i].symbol->name, "main") == 0) {
+      main_function = &functions[i];
+    }
+  }
+  if (main_function == NULL) {
+    fprintf(stderr, "ERROR: the program has no main function to run\n");
+    return false;
+  }
+
+  // Globals start out as zero, as in the data segment of the generated code
+  for (Symbol *symbol = globalScope->symbols; symbol != NULL;
+       symbol = symbol->next) {
+    symbol->value = 0;
+  }
+
+  output = out;
+  statement_count = 0;
+  call_depth = 0;
+  stack_top = 0;
+
+  // main is entered like any other function with no arguments
+  Frame frame = {main_function, 0};
+  if (stack == NULL || (size_t)main_function->nslots > stack_capacity) {
+    stack_capacity = main_function->nslots * 2 + 64;
+    stack = checked_realloc(stack, stack_capacity * sizeof(int));
+  }
+  memset(stack, 0, main_function->nslots * sizeof(int));
+  stack_top = main_function->nslots;
+
+  ASTStore *previous_store = ast_store_bind(main_function->store);
+  call_depth = 1;
+  exec(func_def_body(main_function->func_def), &frame);
+  ast_store_bind(previous_store);
+
+  fflush(out);
+  *statements = statement_count;
+  return true;
+}
@@ -0,0 +1,26 @@
+#ifndef INTERP_H
+#define INTERP_H
+
+#include "ast.h"
+#include "ast_store.h"
+#include <stdio.h>
+
+// Runs a program straight from its syntax trees, without generating code.
+// The parser hands over each finished FUNC_DEF with interp_add_function(),
+// which keeps the tree, the arena or compact store holding it, and the arena
+// holding its function's symbols until interp_reset(). interp_run() then
+// calls main(). Globals live in their symbols' value fields, and each call
+// gets a frame of parameter and local slots on a stack of its own.
+void interp_add_function(void *func_def, ASTArena *arena, ASTStore *store,
+                         ASTArena *symbol_arena);
+
+// Runs main(), writing println output to out. Returns false, after printing
+// an error, if there is no main(). The number of statements executed is
+// stored in *statements. A runtime error, such as a division by zero, is
+// reported and ends the compiler with exit(1).
+bool interp_run(FILE *out, unsigned long *statements);
+
+// Frees the functions added so far
+void interp_reset(void);
+
+#endif
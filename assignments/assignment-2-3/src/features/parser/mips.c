@@ -3,7 +3,6 @@
 #include "symbol_table.h"
 #include "tac.h"
 #include <assert.h>
-#include <ctype.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -42,17 +41,99 @@ MipsInstruction *append_mips_instr(MipsInstruction *list_head,
   return list_head;
 }
 
-Symbol *reverse_symbol_list(Symbol *head) {
-  Symbol *prev = NULL;
-  Symbol *current = head;
-  Symbol *next = NULL;
-  while (current != NULL) {
-    next = current->next;
-    current->next = prev;
-    prev = current;
-    current = next;
+// Temporaries are kept in $t0-$t7. $t8 and $t9 never hold one, so operands
+// that are not temporaries are loaded into them without clobbering a
+// temporary that is still live.
+#define TEMP_REGISTER_COUNT 8
+#define SCRATCH_REG "$t8"
+#define SCRATCH_REG_2 "$t9"
+
+// The register number of each temporary of the function being translated,
+// indexed by temporary number
+static _Thread_local int *temp_registers = NULL;
+
+static bool is_temp(const Operand *op) {
+  return op != NULL && op->operand_type == TEMP_REG;
+}
+
+// Assigns a register to every temporary of the function that starts at enter.
+// A temporary is set once and read later in the same statement, never across
+// a loop's back edge, so it is live from its assignment to its last read in
+// list order. Registers are handed out in that order and freed after the
+// last read.
+static void allocate_temp_registers(Quad *enter) {
+  Quad *end = enter->next;
+  int temp_count = 0;
+  for (; end != NULL && end->op != TAC_ENTER; end = end->next) {
+    Operand *ops[] = {end->src1, end->src2, end->dest};
+    for (int i = 0; i < 3; i++) {
+      if (is_temp(ops[i]) && ops[i]->val.temp >= temp_count) {
+        temp_count = ops[i]->val.temp + 1;
+      }
+    }
+  }
+
+  free(temp_registers);
+  temp_registers = malloc(sizeof(int) * (temp_count + 1));
+  int *last_read = malloc(sizeof(int) * (temp_count + 1));
+  if (!temp_registers || !last_read) {
+    fprintf(stderr, "ERROR: Memory allocation failed\n");
+    exit(1);
+  }
+  for (int t = 0; t < temp_count; t++) {
+    temp_registers[t] = -1;
+    last_read[t] = -1;
+  }
+
+  int position = 0;
+  for (Quad *q = enter->next; q != end; q = q->next, position++) {
+    Operand *reads[] = {q->src1, q->src2};
+    for (int i = 0; i < 2; i++) {
+      if (is_temp(reads[i])) {
+        last_read[reads[i]->val.temp] = position;
+      }
+    }
+  }
+
+  bool in_use[TEMP_REGISTER_COUNT] = {false};
+  position = 0;
+  for (Quad *q = enter->next; q != end; q = q->next, position++) {
+    if (is_temp(q->dest) && temp_registers[q->dest->val.temp] < 0) {
+      int reg = 0;
+      while (reg < TEMP_REGISTER_COUNT && in_use[reg]) {
+        reg++;
+      }
+      if (reg == TEMP_REGISTER_COUNT) {
+        fprintf(stderr,
+                "ERROR: %s needs more than %d temporaries at the same time\n",
+                enter->src1->val.symbol_ptr->name, TEMP_REGISTER_COUNT);
+        exit(1);
+      }
+      temp_registers[q->dest->val.temp] = reg;
+      in_use[reg] = true;
+    }
+
+    // A register is free again once the quad that last reads its temporary
+    // (or sets it, if it is never read) has been translated
+    Operand *ops[] = {q->src1, q->src2, q->dest};
+    for (int i = 0; i < 3; i++) {
+      if (is_temp(ops[i]) && last_read[ops[i]->val.temp] <= position) {
+        int reg = temp_registers[ops[i]->val.temp];
+        if (reg >= 0) {
+          in_use[reg] = false;
+        }
+      }
+    }
   }
-  return prev; // New head
+
+  free(last_read);
+}
+
+// The register that holds temporary operand op
+static void temp_reg(const Operand *op, char *reg, size_t size) {
+  assert(op->operand_type == TEMP_REG);
+  assert(temp_registers != NULL && temp_registers[op->val.temp] >= 0);
+  snprintf(reg, size, "$t%d", temp_registers[op->val.temp]);
 }
 
 MipsInstruction *load_operand_for_branch(Operand *op, const char *target_reg,
@@ -66,23 +147,21 @@ MipsInstruction *load_operand_for_branch(Operand *op, const char *target_reg,
              op->val.integer_const);
     current_mips_head =
         append_mips_instr(current_mips_head, new_mips_instr(buffer));
+  } else if (op->operand_type == TEMP_REG) {
+    char src_reg[16];
+    temp_reg(op, src_reg, sizeof(src_reg));
+    if (strcmp(src_reg, target_reg) != 0) {
+      snprintf(buffer, sizeof(buffer), "    move %s, %s", target_reg, src_reg);
+      current_mips_head =
+          append_mips_instr(current_mips_head, new_mips_instr(buffer));
+    }
   } else if (op->operand_type == SYM_TABLE_PTR) {
     Symbol *sym = op->val.symbol_ptr;
     char *sym_name = sym->name;
-    bool is_temp = (sym_name[0] == 't' && isdigit(sym_name[1]));
-    bool is_global = (!is_temp && sym->scope == globalScope);
-    bool is_local_or_param = (!is_temp && !is_global);
-
-    if (is_temp) {
-      char src_reg[10];
-      snprintf(src_reg, sizeof(src_reg), "$%s", sym_name);
-      if (strcmp(src_reg, target_reg) != 0) {
-        snprintf(buffer, sizeof(buffer), "    move %s, %s", target_reg,
-                 src_reg);
-        current_mips_head =
-            append_mips_instr(current_mips_head, new_mips_instr(buffer));
-      }
-    } else if (is_global) {
+    bool is_global = (sym->flags & SYMBOL_GLOBAL) != 0;
+    bool is_local_or_param = !is_global;
+
+    if (is_global) {
       // Load from global
       snprintf(buffer, sizeof(buffer), "    lw %s, _%s", target_reg, sym_name);
       current_mips_head =
@@ -109,33 +188,50 @@ void get_label_str(Operand *label_op, char *label_buffer, size_t buffer_size) {
   }
 }
 
-MipsInstruction *generate_mips(Quad *tac_list) {
-  MipsInstruction *mips_head = NULL;
-  char buffer[256];
-  char label_str[50];
-  int param_load_temp_idx = 1; // Start at 1 for $t1
-
-  bool main_exists = false;
-  bool println_used = false;
+// Records whether the code defines main and whether it calls println, which
+// decide what generate_mips_runtime() has to add
+void scan_tac_features(Quad *tac_list, bool *main_exists, bool *println_used) {
   for (Quad *q = tac_list; q != NULL; q = q->next) {
     if (q->op == TAC_ENTER && q->src1 &&
         q->src1->operand_type == SYM_TABLE_PTR && q->src1->val.symbol_ptr &&
         strcmp(q->src1->val.symbol_ptr->name, "main") == 0) {
-      main_exists = true;
+      *main_exists = true;
     }
     if (q->op == TAC_CALL && q->src1 &&
         q->src1->operand_type == SYM_TABLE_PTR && q->src1->val.symbol_ptr &&
         strcmp(q->src1->val.symbol_ptr->name, "println") == 0) {
-      println_used = true;
+      *println_used = true;
     }
   }
+}
 
-  bool data_section_added = false;
-  Symbol *original_global_head = globalScope->symbols;
-  Symbol *reversed_globals = reverse_symbol_list(globalScope->symbols);
+// The .data section with one word per global variable, in declaration order.
+// Imported variables get their word in the unit that defines them. The
+// global symbol list is only read, never relinked.
+MipsInstruction *generate_mips_data(void) {
+  MipsInstruction *mips_head = NULL;
+  char buffer[256];
 
-  for (Symbol *sym = reversed_globals; sym != NULL; sym = sym->next) {
-    if (strcmp(sym->type, "variable") == 0 && sym->name[0] != 't') {
+  int global_count = 0;
+  for (Symbol *sym = globalScope->symbols; sym != NULL; sym = sym->next) {
+    global_count++;
+  }
+
+  // The list is newest first
+  Symbol **globals = malloc(sizeof(Symbol *) * (global_count + 1));
+  if (!globals) {
+    fprintf(stderr, "ERROR: Memory allocation failed\n");
+    exit(1);
+  }
+  int i = global_count;
+  for (Symbol *sym = globalScope->symbols; sym != NULL; sym = sym->next) {
+    globals[--i] = sym;
+  }
+
+  bool data_section_added = false;
+  for (i = 0; i < global_count; i++) {
+    Symbol *sym = globals[i];
+    if (sym->kind == SYMBOL_VARIABLE && !(sym->flags & SYMBOL_EXTERN)) {
       if (!data_section_added) {
         mips_head = append_mips_instr(mips_head, new_mips_instr(".data"));
         mips_head = append_mips_instr(mips_head, new_mips_instr(".align 2"));
@@ -146,9 +242,31 @@ MipsInstruction *generate_mips(Quad *tac_list) {
       mips_head = append_mips_instr(mips_head, new_mips_instr(buffer));
     }
   }
-  globalScope->symbols = reverse_symbol_list(reversed_globals);
 
+  free(globals);
+  return mips_head;
+}
+
+MipsInstruction *generate_mips(Quad *tac_list) {
+  bool main_exists = false;
+  bool println_used = false;
+  scan_tac_features(tac_list, &main_exists, &println_used);
+
+  MipsInstruction *mips_head = generate_mips_data();
   mips_head = append_mips_instr(mips_head, new_mips_instr(".text"));
+  mips_head = append_mips_instr(mips_head, generate_mips_text(tac_list));
+  mips_head = append_mips_instr(
+      mips_head, generate_mips_runtime(println_used, main_exists));
+
+  return mips_head;
+}
+
+// Translates the TAC of one or more functions. Only the quads and the symbols
+// they point to are read, so the parser can keep adding globals meanwhile.
+MipsInstruction *generate_mips_text(Quad *tac_list) {
+  MipsInstruction *mips_head = NULL;
+  char buffer[256];
+  char label_str[50];
 
   for (Quad *instruction = tac_list; instruction != NULL;
        instruction = instruction->next) {
@@ -162,6 +280,7 @@ MipsInstruction *generate_mips(Quad *tac_list) {
              src1->val.symbol_ptr);
       Symbol *func_sym = src1->val.symbol_ptr;
       const char *func_name = func_sym->name;
+      allocate_temp_registers(instruction);
 
       snprintf(buffer, sizeof(buffer), "_%s:", func_name);
       mips_head = append_mips_instr(mips_head, new_mips_instr(buffer));
@@ -185,123 +304,61 @@ MipsInstruction *generate_mips(Quad *tac_list) {
     } break;
 
     case TAC_ASSIGN: {
-      assert(dest && dest->operand_type == SYM_TABLE_PTR);
-      assert(src1);
-
-      Symbol *dest_sym = dest->val.symbol_ptr;
-      char *dest_name = dest_sym->name;
-
-      bool is_dest_temp = (dest_name[0] == 't' && isdigit(dest_name[1]));
-      bool is_global_dest = (!is_dest_temp && dest_sym->scope == globalScope);
-      bool is_local_dest = (!is_dest_temp && !is_global_dest);
+      assert(dest && src1);
 
-      if (is_dest_temp) {
-        char dest_reg_mips[10];
-        snprintf(dest_reg_mips, sizeof(dest_reg_mips), "$%s", dest_name);
+      if (dest->operand_type == TEMP_REG) {
+        char dest_reg_mips[16];
+        temp_reg(dest, dest_reg_mips, sizeof(dest_reg_mips));
+        mips_head = load_operand_for_branch(src1, dest_reg_mips, mips_head);
+        break;
+      }
 
-        if (src1->operand_type == INTEGER_CONSTANT) {
-          snprintf(buffer, sizeof(buffer), "    li %s, %d", dest_reg_mips,
-                   src1->val.integer_const);
-          mips_head = append_mips_instr(mips_head, new_mips_instr(buffer));
-        } else if (src1->operand_type == SYM_TABLE_PTR) {
-          Symbol *src_sym = src1->val.symbol_ptr;
-          char *src_name = src_sym->name;
-          bool is_src_temp = (src_name[0] == 't' && isdigit(src_name[1]));
-          bool is_src_global = (!is_src_temp && src_sym->scope == globalScope);
-          bool is_src_local = (!is_src_temp && !is_src_global);
-
-          if (is_src_temp) {
-            char src_reg_mips[10];
-            snprintf(src_reg_mips, sizeof(src_reg_mips), "$%s", src_name);
-            if (strcmp(dest_name, src_name) != 0) {
-              snprintf(buffer, sizeof(buffer), "    move %s, %s", dest_reg_mips,
-                       src_reg_mips);
-              mips_head = append_mips_instr(mips_head, new_mips_instr(buffer));
-            }
-          } else if (is_src_global) {
-            snprintf(buffer, sizeof(buffer), "    lw %s, _%s", dest_reg_mips,
-                     src_name);
-            mips_head = append_mips_instr(mips_head, new_mips_instr(buffer));
-          } else if (is_src_local) {
-            assert(src_sym->offset != 0);
-            snprintf(buffer, sizeof(buffer), "    lw %s, %d($fp)",
-                     dest_reg_mips, src_sym->offset);
-            mips_head = append_mips_instr(mips_head, new_mips_instr(buffer));
-          } else { /* Unhandled Source Symbol */
-          }
-        } else { /* Unhandled Source Operand Type */
-        }
+      assert(dest->operand_type == SYM_TABLE_PTR);
+      Symbol *dest_sym = dest->val.symbol_ptr;
+      bool is_global_dest = (dest_sym->flags & SYMBOL_GLOBAL) != 0;
 
+      // A temporary is stored straight from its register, anything else goes
+      // through the scratch register
+      char temp_reg_for_store[16] = SCRATCH_REG;
+      if (src1->operand_type == TEMP_REG) {
+        temp_reg(src1, temp_reg_for_store, sizeof(temp_reg_for_store));
       } else {
-        char temp_reg_for_store[10] = "$t0";
-
-        if (src1->operand_type == INTEGER_CONSTANT) {
-          snprintf(buffer, sizeof(buffer), "    li %s, %d", temp_reg_for_store,
-                   src1->val.integer_const);
-          mips_head = append_mips_instr(mips_head, new_mips_instr(buffer));
-        } else if (src1->operand_type == SYM_TABLE_PTR) {
-          Symbol *src_sym = src1->val.symbol_ptr;
-          char *src_name = src_sym->name;
-          bool is_src_temp = (src_name[0] == 't' && isdigit(src_name[1]));
-          bool is_src_global = (!is_src_temp && src_sym->scope == globalScope);
-          bool is_src_local = (!is_src_temp && !is_src_global);
-
-          if (is_src_temp) {
-            snprintf(temp_reg_for_store, sizeof(temp_reg_for_store), "$%s",
-                     src_name);
-          } else if (is_src_global) {
-            snprintf(temp_reg_for_store, sizeof(temp_reg_for_store), "$t0");
-            snprintf(buffer, sizeof(buffer), "    lw %s, _%s",
-                     temp_reg_for_store, src_name);
-            mips_head = append_mips_instr(mips_head, new_mips_instr(buffer));
-          } else if (is_src_local) {
-            assert(src_sym->offset != 0);
-            snprintf(temp_reg_for_store, sizeof(temp_reg_for_store), "$t0");
-            snprintf(buffer, sizeof(buffer), "    lw %s, %d($fp)",
-                     temp_reg_for_store, src_sym->offset);
-            mips_head = append_mips_instr(mips_head, new_mips_instr(buffer));
-          } else { /* Unhandled Source Symbol */
-          }
-        } else { /* Unhandled Source Operand Type */
-        }
+        mips_head =
+            load_operand_for_branch(src1, temp_reg_for_store, mips_head);
+      }
 
-        if (is_global_dest) {
-          snprintf(buffer, sizeof(buffer), "    sw %s, _%s", temp_reg_for_store,
-                   dest_name);
-          mips_head = append_mips_instr(mips_head, new_mips_instr(buffer));
-        } else if (is_local_dest) {
-          assert(dest_sym->offset != 0);
-          snprintf(buffer, sizeof(buffer), "    sw %s, %d($fp)",
-                   temp_reg_for_store, dest_sym->offset);
-          mips_head = append_mips_instr(mips_head, new_mips_instr(buffer));
-        } else { /* Should not happen */
-        }
+      if (is_global_dest) {
+        snprintf(buffer, sizeof(buffer), "    sw %s, _%s", temp_reg_for_store,
+                 dest_sym->name);
+        mips_head = append_mips_instr(mips_head, new_mips_instr(buffer));
+      } else {
+        assert(dest_sym->offset != 0);
+        snprintf(buffer, sizeof(buffer), "    sw %s, %d($fp)",
+                 temp_reg_for_store, dest_sym->offset);
+        mips_head = append_mips_instr(mips_head, new_mips_instr(buffer));
       }
     } break;
 
     case TAC_PARAM: {
       assert(instruction->src1);
       Operand *param_op = instruction->src1;
-      char param_push_reg[10];
+      char param_push_reg[16];
 
-      if (param_op->operand_type == SYM_TABLE_PTR) {
+      if (param_op->operand_type == TEMP_REG) {
+        temp_reg(param_op, param_push_reg, sizeof(param_push_reg));
+      } else if (param_op->operand_type == SYM_TABLE_PTR) {
         Symbol *param_sym = param_op->val.symbol_ptr;
         char *param_name = param_sym->name;
-        bool is_param_temp = (param_name[0] == 't' && isdigit(param_name[1]));
-        bool is_param_global =
-            (!is_param_temp && param_sym->scope == globalScope);
-        bool is_param_local = (!is_param_temp && !is_param_global);
+        bool is_param_global = (param_sym->flags & SYMBOL_GLOBAL) != 0;
+        bool is_param_local = !is_param_global;
 
-        if (is_param_temp) {
-          snprintf(param_push_reg, sizeof(param_push_reg), "$%s", param_name);
-        } else if (is_param_local) {
-          const char *load_reg = "$t0";
+        if (is_param_local) {
+          const char *load_reg = SCRATCH_REG;
 
           snprintf(param_push_reg, sizeof(param_push_reg), "%s", load_reg);
 
           assert(param_sym->offset != 0 ||
-                 (param_sym->type &&
-                  strcmp(param_sym->type, "parameter") == 0 &&
+                 (param_sym->kind == SYMBOL_PARAMETER &&
                   param_sym->offset > 0));
 
           snprintf(buffer, sizeof(buffer), "    lw %s, %d($fp)", load_reg,
@@ -309,19 +366,15 @@ MipsInstruction *generate_mips(Quad *tac_list) {
           mips_head = append_mips_instr(mips_head, new_mips_instr(buffer));
 
         } else if (is_param_global) {
-          char load_reg[10];
-          snprintf(load_reg, sizeof(load_reg), "$t%d", param_load_temp_idx);
+          const char *load_reg = SCRATCH_REG;
           snprintf(param_push_reg, sizeof(param_push_reg), "%s", load_reg);
           snprintf(buffer, sizeof(buffer), "    lw %s, _%s", load_reg,
                    param_name);
           mips_head = append_mips_instr(mips_head, new_mips_instr(buffer));
-          param_load_temp_idx += 2;
-          if (param_load_temp_idx > 7)
-            param_load_temp_idx = 1;
         } else { /* Should not happen */
         }
       } else if (param_op->operand_type == INTEGER_CONSTANT) {
-        const char *load_reg = "$t0";
+        const char *load_reg = SCRATCH_REG;
         snprintf(param_push_reg, sizeof(param_push_reg), "%s", load_reg);
         snprintf(buffer, sizeof(buffer), "    li %s, %d", load_reg,
                  param_op->val.integer_const);
@@ -390,8 +443,21 @@ MipsInstruction *generate_mips(Quad *tac_list) {
     case TAC_IF_GE: {
       assert(src1 && src2 && dest && dest->operand_type == INTEGER_CONSTANT);
 
-      mips_head = load_operand_for_branch(src1, "$t0", mips_head);
-      mips_head = load_operand_for_branch(src2, "$t1", mips_head);
+      // A temporary is compared in its own register. Anything else is loaded
+      // into a scratch register, so loading one operand cannot overwrite the
+      // other, even when the other is the result of a call in the condition.
+      char src1_reg[16] = SCRATCH_REG;
+      char src2_reg[16] = SCRATCH_REG_2;
+      if (src1->operand_type == TEMP_REG) {
+        temp_reg(src1, src1_reg, sizeof(src1_reg));
+      } else {
+        mips_head = load_operand_for_branch(src1, src1_reg, mips_head);
+      }
+      if (src2->operand_type == TEMP_REG) {
+        temp_reg(src2, src2_reg, sizeof(src2_reg));
+      } else {
+        mips_head = load_operand_for_branch(src2, src2_reg, mips_head);
+      }
       get_label_str(dest, label_str, sizeof(label_str));
       char *branch_op;
       switch (instruction->op) {
@@ -417,22 +483,19 @@ MipsInstruction *generate_mips(Quad *tac_list) {
         branch_op = "###";
         break;
       }
-      snprintf(buffer, sizeof(buffer), "    %s $t0, $t1, %s", branch_op,
-               label_str);
+      snprintf(buffer, sizeof(buffer), "    %s %s, %s, %s", branch_op,
+               src1_reg, src2_reg, label_str);
       mips_head = append_mips_instr(mips_head, new_mips_instr(buffer));
     } break;
     case TAC_SET_RETVAL: {
       assert(src1);
-      mips_head = load_operand_for_branch(src1, "$t0", mips_head);
-      snprintf(buffer, sizeof(buffer), "    move $v0, $t0");
-      mips_head = append_mips_instr(mips_head, new_mips_instr(buffer));
+      mips_head = load_operand_for_branch(src1, "$v0", mips_head);
     } break;
 
     case TAC_RETRIEVE: {
-      assert(dest && dest->operand_type == SYM_TABLE_PTR &&
-             dest->val.symbol_ptr);
-      char dest_reg[10];
-      snprintf(dest_reg, sizeof(dest_reg), "$%s", dest->val.symbol_ptr->name);
+      assert(dest && dest->operand_type == TEMP_REG);
+      char dest_reg[16];
+      temp_reg(dest, dest_reg, sizeof(dest_reg));
       snprintf(buffer, sizeof(buffer), "    move %s, $v0", dest_reg);
       mips_head = append_mips_instr(mips_head, new_mips_instr(buffer));
     } break;
@@ -445,6 +508,15 @@ MipsInstruction *generate_mips(Quad *tac_list) {
     }
   }
 
+  free(temp_registers);
+  temp_registers = NULL;
+  return mips_head;
+}
+
+// The println routine and the entry stub, emitted once after all functions
+MipsInstruction *generate_mips_runtime(bool println_used, bool main_exists) {
+  MipsInstruction *mips_head = NULL;
+
   if (println_used) {
     mips_head = append_mips_instr(mips_head, new_mips_instr(".align 2"));
 
@@ -496,18 +568,33 @@ char *mips_list_to_string(MipsInstruction *mips_list) {
     perror("Failed to allocate string for MIPS output");
     return NULL;
   }
-  result_string[0] = '\0';
 
+  // Copy at a running end pointer; strcat would rescan the whole string for
+  // every line
+  char *end = result_string;
   for (MipsInstruction *curr = mips_list; curr != NULL; curr = curr->next) {
     if (curr->instruction) {
-      strcat(result_string, curr->instruction);
+      size_t len = strlen(curr->instruction);
+      memcpy(end, curr->instruction, len);
+      end += len;
     }
-    strcat(result_string, "\n");
+    *end++ = '\n';
   }
+  *end = '\0';
 
   return result_string;
 }
 
+// Writes the same text as mips_list_to_string() without building it first
+void print_mips_list(MipsInstruction *mips_list, FILE *out) {
+  for (MipsInstruction *curr = mips_list; curr != NULL; curr = curr->next) {
+    if (curr->instruction) {
+      fputs(curr->instruction, out);
+    }
+    fputc('\n', out);
+  }
+}
+
 void free_mips_list(MipsInstruction *mips_list) {
   MipsInstruction *current = mips_list;
   MipsInstruction *next = NULL;
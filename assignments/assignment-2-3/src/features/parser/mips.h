@@ -1,6 +1,8 @@
 #ifndef MIPS_H
 #define MIPS_H
 
+#include <stdbool.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include "tac.h"
 
@@ -12,7 +14,15 @@ typedef struct MipsInstruction {
 
 // Function prototypes
 MipsInstruction* generate_mips(Quad *tac_list);
+
+// The phases of generate_mips(), for callers that translate one function at
+// a time
+void scan_tac_features(Quad *tac_list, bool *main_exists, bool *println_used);
+MipsInstruction* generate_mips_data(void);
+MipsInstruction* generate_mips_text(Quad *tac_list);
+MipsInstruction* generate_mips_runtime(bool println_used, bool main_exists);
 char* mips_list_to_string(MipsInstruction *mips_list);
+void print_mips_list(MipsInstruction *mips_list, FILE *out);
 void free_mips_list(MipsInstruction *mips_list); // Important for cleanup
 
 #endif // MIPS_H
@@ -3,6 +3,9 @@
 #include "./symbol_table.h"
 #include "./token_service.h"
 #include "ast.h"
+#include "inline.h"
+#include "pure_eval.h"
+#include "sym_file.h"
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -11,6 +14,11 @@
 extern int chk_decl_flag;
 extern int print_ast_flag;
 extern int gen_code_flag;
+extern int run_flag;
+extern int ast_stats_flag;
+extern char *export_sym_path;
+extern char **import_sym_paths;
+extern int import_sym_count;
 
 // Global variables
 Scope *globalScope = NULL;
@@ -19,13 +27,25 @@ Scope *currentScope = NULL;
 // Function to perform parsing with grammar rules
 ASTnode *parse_with_grammar_rules() {
   initSymbolTable();
+  for (int i = 0; i < import_sym_count; i++) {
+    if (!sym_file_import(import_sym_paths[i])) {
+      exit(1);
+    }
+  }
   init_grammar_rules();
   advanceToken();
 
   GrammarRule *prog = get_rule("prog");
   ASTnode *proj_node = prog->parse(prog);
 
+  if (export_sym_path != NULL &&
+      !sym_file_write(globalScope, export_sym_path)) {
+    exit(1);
+  }
+
   cleanup_grammar_rules();
+  inline_reset();
+  pure_eval_reset();
   return proj_node;
 }
 
@@ -33,7 +53,8 @@ ASTnode *parse_with_grammar_rules() {
 bool DEBUG_ON = false;
 
 int parse(void) {
-  if (print_ast_flag || gen_code_flag) {
+  if (print_ast_flag || gen_code_flag || run_flag || ast_stats_flag ||
+      export_sym_path != NULL || import_sym_count > 0) {
     chk_decl_flag = 1;
   }
 
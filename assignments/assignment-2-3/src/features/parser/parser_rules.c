@@ -2,6 +2,16 @@
 #include "ast.h"
 #include "grammar_rule.h"
 #include "mips.h"
+#include "ast_dump.h"
+#include "ast_file.h"
+#include "ast_stats.h"
+#include "ast_store.h"
+#include "fold.h"
+#include "inline.h"
+#include "interp.h"
+#include "pipeline.h"
+#include "pure_eval.h"
+#include "stream.h"
 #include "symbol_table.h"
 #include "tac.h"
 #include "token_service.h"
@@ -9,12 +19,23 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
 // External variables
 extern int chk_decl_flag;
 extern int print_ast_flag;
 extern int gen_code_flag;
-extern int DEBUG_ON;
+extern int pipeline_flag;
+extern int compact_ast_flag;
+extern int stream_flag;
+extern int fold_flag;
+extern int hash_cons_flag;
+extern int run_flag;
+extern int ast_stats_flag;
+extern int inline_flag;
+extern char *save_ast_dir;
+extern ASTDumpFormat ast_format;
+extern bool DEBUG_ON;
 int PAR_DEBUG_ON = true;
 
 // Forward declarations for all parse functions
@@ -35,12 +56,19 @@ ASTnode *parse_if_stmt_impl(const GrammarRule *rule);
 ASTnode *parse_assg_stmt_impl(const GrammarRule *rule);
 ASTnode *parse_return_stmt_impl(const GrammarRule *rule);
 ASTnode *parse_fn_call_impl(const GrammarRule *rule);
-ASTnode *parse_opt_expr_list_impl(const GrammarRule *rule,
-                                  Symbol *function_symbol);
-ASTnode *parse_expr_list_impl(const GrammarRule *rule, Symbol *function_symbol);
+ASTnode *parse_call_exp(const GrammarRule *rule);
+ASTnode *parse_opt_expr_list_impl(const GrammarRule *rule);
+ASTnode *parse_expr_list_impl(const GrammarRule *rule);
 ASTnode *parse_bool_exp_impl(const GrammarRule *rule);
-ASTnode *parse_arith_exp_impl(const GrammarRule *rule, Symbol *function_symbol);
+ASTnode *parse_bool_term_impl(const GrammarRule *rule);
+ASTnode *parse_bool_factor_impl(const GrammarRule *rule);
+ASTnode *parse_arith_exp_impl(const GrammarRule *rule);
 ASTnode *parse_relop_impl(const GrammarRule *rule);
+static NodeType parse_relop_type(const GrammarRule *rule);
+
+// Symbol of the function whose definition is being parsed, which its formals
+// are added to, or NULL between functions
+static Symbol *current_function = NULL;
 
 void debug(char *source) {
   if (DEBUG_ON && PAR_DEBUG_ON) {
@@ -49,33 +77,18 @@ void debug(char *source) {
   }
 }
 
-// Calls the symbol_table lookup function to search the entire table for the
-// symbol
-bool lookup(const char *name, const char *type) {
-  if (!chk_decl_flag) {
-    return true;
-  }
-
-  Symbol *symbol = lookup_symbol_in_table(name, type);
-  if (symbol == NULL) {
-    return NULL;
-  }
-
-  return true;
-}
-
 // Helper function to create and store a symbol
-bool add_symbol_check(const char *name, const char *type) {
+bool add_symbol_check(const char *name, SymbolKind kind) {
   if (!chk_decl_flag)
     return true;
 
-  if (check_duplicate_symbol_in_scope(name, type, currentScope)) {
+  if (check_duplicate_symbol_in_scope(name, currentScope)) {
     fprintf(stderr, "ERROR: LINE %d: duplicate %s declaration\n",
             currentToken.line, name);
     exit(1);
   }
 
-  if (strcmp(type, "function") == 0) {
+  if (kind == SYMBOL_FUNCTION) {
     debug("added function symbol");
     return add_function_symbol(name);
   } else {
@@ -103,12 +116,110 @@ char *capture_identifier() {
 
 // Implementation of all parse functions
 
+// Writes a function's tree to save_ast_dir/<name>.ast, copying it into a
+// store first unless it already is in one
+static void save_function_ast(ASTnode *func_node, ASTStore *func_store) {
+  ASTStore *store = func_store ? func_store : ast_store_build(func_node);
+
+  ASTStore *previous_store = ast_store_bind(store);
+  const char *name = func_def_name(ast_store_root(store));
+  ast_store_bind(previous_store);
+
+  size_t path_size = strlen(save_ast_dir) + strlen(name) + 6;
+  char *path = malloc(path_size);
+  if (!path) {
+    fprintf(stderr, "ERROR: memory allocation failure\n");
+    exit(1);
+  }
+  snprintf(path, path_size, "%s/%s.ast", save_ast_dir, name);
+
+  if (!ast_file_write(store, path)) {
+    exit(1);
+  }
+
+  free(path);
+  if (store != func_store) {
+    ast_store_destroy(store);
+  }
+}
+
+// Arena of the tree most recently returned by parse_prog_impl(), and of its
+// function's symbols
+static ASTArena *retained_arena = NULL;
+static ASTArena *retained_symbol_arena = NULL;
+
+// Symbol arenas of the functions whose quads wait in the code list of a batch
+// compile. They go once the program's code has been emitted.
+static ASTArena **batch_symbol_arenas = NULL;
+static int batch_symbol_arena_count = 0;
+static int batch_symbol_arena_capacity = 0;
+
+static void release_symbol_arena(ASTArena *arena, bool batched) {
+  if (!batched || arena == NULL) {
+    ast_arena_destroy(arena);
+    return;
+  }
+
+  if (batch_symbol_arena_count == batch_symbol_arena_capacity) {
+    batch_symbol_arena_capacity = (batch_symbol_arena_capacity == 0)
+                                      ? 16
+                                      : batch_symbol_arena_capacity * 2;
+    ASTArena **new_arenas =
+        realloc(batch_symbol_arenas,
+                batch_symbol_arena_capacity * sizeof(ASTArena *));
+    if (!new_arenas) {
+      fprintf(stderr, "ERROR: Memory allocation failed\n");
+      exit(1);
+    }
+    batch_symbol_arenas = new_arenas;
+  }
+  batch_symbol_arenas[batch_symbol_arena_count++] = arena;
+}
+
+static void release_batch_symbol_arenas(void) {
+  for (int i = 0; i < batch_symbol_arena_count; i++) {
+    ast_arena_destroy(batch_symbol_arenas[i]);
+  }
+  free(batch_symbol_arenas);
+  batch_symbol_arenas = NULL;
+  batch_symbol_arena_count = 0;
+  batch_symbol_arena_capacity = 0;
+}
+
+// Buffers --print_ast output for the whole program
+static ASTDumper *ast_dumper = NULL;
+
+// A syntax error exits from deep in the parser; the trees printed before it
+// must still come out
+static void flush_ast_dumper(void) {
+  if (ast_dumper != NULL) {
+    ast_dumper_flush(ast_dumper);
+  }
+}
+
 // Program rule:
 ASTnode *parse_prog_impl(const GrammarRule *rule) {
   debug("parse_prog_impl");
 
   ASTnode *func_node = NULL;
   Quad *code_list = NULL;
+  ASTStats program_stats;
+  memset(&program_stats, 0, sizeof(ASTStats));
+
+  // With --run every tree is kept for the interpreter, so code for the
+  // program is generated in one batch
+  bool pipelined = gen_code_flag && pipeline_flag && !run_flag;
+  bool streaming = gen_code_flag && stream_flag && !pipelined && !run_flag;
+  if (pipelined) {
+    pipeline_start();
+  } else if (streaming) {
+    stream_start();
+  }
+
+  if (print_ast_flag && ast_dumper == NULL) {
+    ast_dumper = ast_dumper_create(STDOUT_FILENO, ast_format);
+    atexit(flush_ast_dumper);
+  }
 
   // Check first
   while (rule->isFirst(rule, currentToken)) {
@@ -130,13 +241,116 @@ ASTnode *parse_prog_impl(const GrammarRule *rule) {
       exit(1);
     }
 
-    // Call decl_or_func rule
+    // Call decl_or_func rule. Each function's tree gets its own arena, which
+    // is released in one go as soon as the tree has been lowered. Its locals
+    // and scopes get another, released once its code has been emitted.
     debug("prog calls decl_or_func");
     const GrammarRule *decl_or_func = get_rule("decl_or_func");
+    ASTArena *function_arena = ast_arena_create();
+    ast_arena_set_hash_consing(function_arena, hash_cons_flag);
+    ASTArena *previous_arena = ast_arena_use(function_arena);
+    ASTArena *symbol_arena = ast_arena_create();
+    ASTArena *previous_symbol_arena = symbol_use_arena(symbol_arena);
+    size_t symbol_bytes_before = symbol_table_bytes();
     func_node = decl_or_func->parse(decl_or_func);
+    if (gen_code_flag && fold_flag && func_node != NULL) {
+      pure_eval_calls(func_node);
+    }
+    if (gen_code_flag && inline_flag && func_node != NULL) {
+      inline_calls(func_node);
+    }
+    if (gen_code_flag && fold_flag && func_node != NULL) {
+      func_node = fold_constants(func_node);
+    }
+    if (gen_code_flag && inline_flag && func_node != NULL) {
+      inline_register(func_node);
+    }
+    if (gen_code_flag && fold_flag && func_node != NULL) {
+      pure_eval_register(func_node);
+    }
+    symbol_use_arena(previous_symbol_arena);
+    ast_arena_use(previous_arena);
+
+    if (DEBUG_ON && func_node != NULL) {
+      ast_arena_print_stats(function_arena, stderr);
+    }
+
+    if (ast_stats_flag && func_node != NULL) {
+      ASTStats stats;
+      ast_stats_collect(func_node, &stats);
+      stats.node_bytes = ast_arena_bytes_used(function_arena);
+      stats.symbol_bytes = symbol_table_bytes() - symbol_bytes_before;
+      ast_stats_print(func_def_name(func_node), &stats, ast_format, stderr);
+      ast_stats_add(&program_stats, &stats);
+    }
+
+    // With --compact_ast the tree is copied into an index-based store right
+    // away and everything after the parser reads it through handles
+    void *func_tree = func_node;
+    ASTStore *func_store = NULL;
+    if (compact_ast_flag && func_node != NULL) {
+      func_store = ast_store_build(func_node);
+      ast_arena_destroy(function_arena);
+      function_arena = NULL;
+      func_tree = ast_store_root(func_store);
+      func_node = NULL;
+    }
+
+    if (save_ast_dir != NULL && func_tree != NULL) {
+      save_function_ast(func_node, func_store);
+    }
+
+    if (print_ast_flag && func_tree != NULL) {
+      ASTStore *previous_store = ast_store_bind(func_store);
+      ast_dump(ast_dumper, func_tree);
+      ast_store_bind(previous_store);
+      if (streaming) {
+        // Keeps the tree ahead of the code emitted for it
+        ast_dumper_flush(ast_dumper);
+      }
+    }
+
+    if (pipelined && func_tree != NULL) {
+      // The backend lowers this function while the next one is parsed and
+      // releases the tree when it is done with it
+      pipeline_submit(func_tree, function_arena, func_store, symbol_arena);
+      func_node = NULL;
+      continue;
+    }
+
+    if (streaming && func_tree != NULL) {
+      // Emitted and released before the next function is parsed
+      stream_function(func_tree, function_arena, func_store, symbol_arena);
+      func_node = NULL;
+      continue;
+    }
 
     if (gen_code_flag) {
-      make_TAC(func_node, &code_list);
+      // The quads and spill slots go with the function's symbols
+      ASTArena *previous_tac_arena = tac_use_arena(symbol_arena);
+      ASTStore *previous_store = ast_store_bind(func_store);
+      make_TAC(func_tree, &code_list);
+      ast_store_bind(previous_store);
+      tac_use_arena(previous_tac_arena);
+    }
+
+    if (run_flag && func_tree != NULL) {
+      // The interpreter owns the tree and the symbols from here on
+      interp_add_function(func_tree, function_arena, func_store, symbol_arena);
+      continue;
+    }
+    ast_store_destroy(func_store);
+
+    if (func_node != NULL) {
+      // The last function's tree is returned to the caller, so its arenas
+      // are kept until the next function replaces it
+      ast_arena_destroy(retained_arena);
+      retained_arena = function_arena;
+      release_symbol_arena(retained_symbol_arena, gen_code_flag);
+      retained_symbol_arena = symbol_arena;
+    } else {
+      ast_arena_destroy(function_arena);
+      release_symbol_arena(symbol_arena, gen_code_flag);
     }
   }
 
@@ -148,7 +362,21 @@ ASTnode *parse_prog_impl(const GrammarRule *rule) {
     exit(1);
   }
 
-  if (gen_code_flag) {
+  if (ast_dumper != NULL) {
+    ast_dumper_flush(ast_dumper);
+  }
+
+  if (ast_stats_flag) {
+    // Globals and the scopes are counted here too
+    program_stats.symbol_bytes = symbol_table_bytes();
+    ast_stats_print(NULL, &program_stats, ast_format, stderr);
+  }
+
+  if (pipelined) {
+    pipeline_finish();
+  } else if (streaming) {
+    stream_finish();
+  } else if (gen_code_flag) {
 
     Quad *reversed_code_list = reverse_tac_list(code_list);
 
@@ -159,6 +387,7 @@ ASTnode *parse_prog_impl(const GrammarRule *rule) {
     output_string = mips_list_to_string(mips_list);
 
     printf("%s", output_string);
+    release_batch_symbol_arenas();
   }
 
   return func_node;
@@ -176,7 +405,7 @@ ASTnode *parse_decl_or_func_impl(const GrammarRule *rule) {
   char *id_name = capture_identifier();
   // Check var_decl rule
   if (lookahead_token.type == TOKEN_COMMA) {
-    if (add_symbol_check(id_name, "variable") == false) {
+    if (add_symbol_check(id_name, SYMBOL_VARIABLE) == false) {
       report_error(rule->name, "failed to add variable id to symbol table");
       exit(1);
     }
@@ -186,31 +415,37 @@ ASTnode *parse_decl_or_func_impl(const GrammarRule *rule) {
     var_decl->parse(var_decl);
     return NULL;
   } else if (lookahead_token.type == TOKEN_LPAREN) {
-    if (add_symbol_check(id_name, "function") == false) {
+    if (add_symbol_check(id_name, SYMBOL_FUNCTION) == false) {
       report_error(rule->name, "failed to add variable id to symbol table");
       exit(1);
     }
+    current_function = lookup_symbol_in_scope(id_name, SYMBOL_FUNCTION,
+                                              currentScope);
+
     // Call func_defn
     debug("decl_or_func calls func_defn");
     const GrammarRule *func_defn = get_rule("func_defn");
     ASTnode *func_defn_node = func_defn->parse(func_defn);
 
-    func_defn_node->symbol = lookup_symbol_in_table(id_name, "function");
+    func_defn_node->symbol = current_function;
 
     if (func_defn_node->symbol == NULL) {
       report_error(rule->name, "Could not find symbol");
       exit(1);
     }
 
-    if (print_ast_flag) {
-      print_ast(func_defn_node);
-    }
+    // Size the frame for the locals declared in the body. They start at
+    // -8($fp), so the lowest one is at current_offset + 4.
+    int local_bytes = -(currentScope->current_offset + 4);
+    func_defn_node->symbol->local_var_bytes =
+        (local_bytes > 4) ? local_bytes : 0;
 
     popScope();
+    current_function = NULL;
     return func_defn_node;
   } else {
     // This case exists for when only a single variable is defined
-    if (add_symbol_check(id_name, "variable") == false) {
+    if (add_symbol_check(id_name, SYMBOL_VARIABLE) == false) {
       report_error(rule->name, "failed to add variable id to symbol table");
       exit(1);
     }
@@ -225,6 +460,20 @@ ASTnode *parse_decl_or_func_impl(const GrammarRule *rule) {
   return NULL;
 }
 
+// Adds the formal id to the function being defined and to the body's scope
+static void add_formal(const char *id) {
+  if (!chk_decl_flag) {
+    return;
+  }
+
+  if (check_duplicate_symbol_in_scope(id, currentScope)) {
+    fprintf(stderr, "ERROR: LINE %d: duplicate %s declaration\n",
+            currentToken.line, id);
+    exit(1);
+  }
+  add_function_formal(current_function, id);
+}
+
 ASTnode *parse_func_defn_impl(const GrammarRule *rule) {
   // Parse LPAREN
   if (!match(TOKEN_LPAREN)) {
@@ -294,18 +543,8 @@ ASTnode *parse_opt_formals_impl(const GrammarRule *rule) {
     report_error(rule->name, "expected an ID but found NULL");
     exit(1);
   }
-  if (chk_decl_flag) {
-    debug("adding formal");
-    if (!add_function_formal(id)) {
-      report_error(rule->name, "failed to add formal to function");
-      exit(1);
-    }
-  }
-  debug("checking symbol");
-  if (!add_symbol_check(id, "variable")) {
-    report_error(rule->name, "failed to add formal to symbol table");
-    exit(1);
-  }
+  debug("adding formal");
+  add_formal(id);
 
   // Parse formals
   debug("opt_formals calls formals");
@@ -336,16 +575,7 @@ ASTnode *parse_formals_impl(const GrammarRule *rule) {
 
   // Parse ID
   char *id = capture_identifier();
-  if (chk_decl_flag) {
-    if (!add_function_formal(id)) {
-      report_error(rule->name, "failed to add formal to function");
-      exit(1);
-    }
-  }
-  if (!add_symbol_check(id, "variable")) {
-    report_error(rule->name, "failed to add formal to symbol table");
-    exit(1);
-  }
+  add_formal(id);
 
   debug("formals calls formals");
   rule->parse(rule);
@@ -368,7 +598,7 @@ ASTnode *parse_opt_var_decls_impl(const GrammarRule *rule) {
 
   // parse ID
   char *id = capture_identifier();
-  if (!add_symbol_check(id, "variable")) {
+  if (!add_symbol_check(id, SYMBOL_VARIABLE)) {
     report_error(rule->name, "failed to add id to symbol table");
     exit(1);
   }
@@ -384,22 +614,48 @@ ASTnode *parse_opt_var_decls_impl(const GrammarRule *rule) {
   return NULL;
 }
 
+// Growable buffer for the items of a list while it is being parsed. The
+// finished list node gets its own copy of the items.
+typedef struct {
+  ASTnode **items;
+  int count;
+  int capacity;
+} ListBuffer;
+
+static void list_buffer_append(ListBuffer *list, ASTnode *item) {
+  if (list->count == list->capacity) {
+    int new_capacity = (list->capacity == 0) ? 8 : list->capacity * 2;
+    ASTnode **new_items =
+        realloc(list->items, new_capacity * sizeof(ASTnode *));
+    if (!new_items) {
+      fprintf(stderr, "ERROR: Memory allocation failed\n");
+      exit(1);
+    }
+    list->items = new_items;
+    list->capacity = new_capacity;
+  }
+  list->items[list->count++] = item;
+}
+
+// opt_stmt_list : stmt opt_stmt_list | epsilon, parsed as a loop so the block
+// becomes a single flat STMT_LIST
 ASTnode *parse_opt_stmt_list_impl(const GrammarRule *rule) {
   if (!rule->isFirst(rule, currentToken)) {
     return NULL; // Epsilon
   }
 
-  // Parse stmt
-  debug("opt_stmt_list calls stmt");
+  ListBuffer stmts = {NULL, 0, 0};
   const GrammarRule *stmt = get_rule("stmt");
-  ASTnode *stmt_node = stmt->parse(stmt);
 
-  // Parse opt_stmt_list
-  debug("opt_stmt_list calls opt_stmt_list");
-  ASTnode *opt_stmt_list_node = rule->parse(rule);
+  while (rule->isFirst(rule, currentToken)) {
+    // Parse stmt
+    debug("opt_stmt_list calls stmt");
+    // An empty statement (a lone ; or {}) is kept as a NULL item
+    list_buffer_append(&stmts, stmt->parse(stmt));
+  }
 
-  ASTnode *stmt_list_node =
-      create_stmt_list_node(stmt_node, opt_stmt_list_node);
+  ASTnode *stmt_list_node = create_stmt_list_node(stmts.items, stmts.count);
+  free(stmts.items);
 
   return stmt_list_node;
 }
@@ -488,12 +744,14 @@ ASTnode *parse_assg_or_fn_impl(const GrammarRule *rule) {
   exit(1);
 }
 
-ASTnode *parse_fn_call_impl(const GrammarRule *rule) {
+// Parses ID LPAREN opt_expr_list RPAREN. Shared by the fn_call statement and
+// by calls that appear inside an arith_exp.
+ASTnode *parse_call_exp(const GrammarRule *rule) {
   // Parse ID
   char *id = capture_identifier();
   Symbol *function_symbol = NULL;
   if (chk_decl_flag) {
-    function_symbol = lookup_symbol_in_scope(id, "function", globalScope);
+    function_symbol = lookup_symbol_in_scope(id, SYMBOL_FUNCTION, globalScope);
     if (!function_symbol) {
       report_error(rule->name, "ID does not exist");
       free(id);
@@ -507,26 +765,22 @@ ASTnode *parse_fn_call_impl(const GrammarRule *rule) {
     free(id);
   }
 
-  int number_of_arguments = 0;
-  if (chk_decl_flag) {
-    number_of_arguments = function_symbol->number_of_arguments;
-  }
-
   // Parse opt_expr_list
   debug("fn_call calls opt_expr_list");
   const GrammarRule *opt_expr_list = get_rule("opt_expr_list");
-  ASTnode *expr_list_node =
-      opt_expr_list->parseEx(opt_expr_list, function_symbol);
-
-  if (chk_decl_flag) {
-    if (strcmp(function_symbol->name, "println") == 0) {
-      // continue
-    } else if (function_symbol->number_of_arguments != 0) {
+  ASTnode *expr_list_node = opt_expr_list->parse(opt_expr_list);
+
+  // The arguments are checked against the callee's arity once the list is
+  // closed. The callee's symbol is only read.
+  if (chk_decl_flag && strcmp(function_symbol->name, "println") != 0) {
+    int nargs = (expr_list_node != NULL) ? expr_list_length(expr_list_node) : 0;
+    if (nargs > function_symbol->number_of_arguments) {
+      report_error(rule->name, "too many arguments provided in function call");
+      exit(1);
+    } else if (nargs < function_symbol->number_of_arguments) {
       report_error(rule->name, "wrong number of arguments provided");
       exit(1);
     }
-
-    function_symbol->number_of_arguments = number_of_arguments;
   }
 
   // Parse RPAREN
@@ -536,22 +790,26 @@ ASTnode *parse_fn_call_impl(const GrammarRule *rule) {
     exit(1);
   }
 
+  ASTnode *fn_call_node =
+      create_func_call_node(function_symbol, expr_list_node);
+
+  free(id);
+  return fn_call_node;
+}
+
+ASTnode *parse_fn_call_impl(const GrammarRule *rule) {
+  ASTnode *fn_call_node = parse_call_exp(rule);
+
   // Parse SEMI
   if (!match(TOKEN_SEMI)) {
     report_error(rule->name, "expected SEMI");
-    free(id);
     exit(1);
   }
 
-  ASTnode *fn_call_node =
-      create_func_call_node(function_symbol, expr_list_node);
-
-  free(id);
   return fn_call_node;
 }
 
-ASTnode *parse_opt_expr_list_impl(const GrammarRule *rule,
-                                  Symbol *function_symbol) {
+ASTnode *parse_opt_expr_list_impl(const GrammarRule *rule) {
 
   if (!rule->isFirst(rule, currentToken)) {
     return NULL; // Epsilon
@@ -560,69 +818,48 @@ ASTnode *parse_opt_expr_list_impl(const GrammarRule *rule,
   // Parse expr_list
   debug("opt_expr_list calls expr_list");
   const GrammarRule *expr_list = get_rule("expr_list");
-  return expr_list->parseEx(expr_list, function_symbol);
+  return expr_list->parse(expr_list);
 }
 
-ASTnode *parse_expr_list_impl(const GrammarRule *rule,
-                              Symbol *function_symbol) {
-  if (!rule->isFirst(rule, currentToken)) {
-    report_error(rule->name, "unexpected token in expr_list");
-    exit(1);
-  }
-
-  // Parse arith_exp
-  debug("expr_list calls arith_exp");
+ASTnode *parse_expr_list_impl(const GrammarRule *rule) {
+  ListBuffer args = {NULL, 0, 0};
   const GrammarRule *arith_exp = get_rule("arith_exp");
-  ASTnode *arith_node = arith_exp->parseEx(arith_exp, function_symbol);
 
-  ASTnode *opt_expr_list_node = NULL; // Parse optional COMMA
-  if (match(TOKEN_COMMA)) {
-    // Parse expr_list
-    opt_expr_list_node = rule->parseEx(rule, function_symbol);
-  }
+  // expr_list : arith_exp { COMMA arith_exp }
+  do {
+    if (!rule->isFirst(rule, currentToken)) {
+      report_error(rule->name, "unexpected token in expr_list");
+      exit(1);
+    }
 
-  return create_expr_list_node(arith_node, opt_expr_list_node);
+    // Parse arith_exp
+    debug("expr_list calls arith_exp");
+    list_buffer_append(&args, arith_exp->parse(arith_exp));
+  } while (match(TOKEN_COMMA));
+
+  ASTnode *expr_list_node = create_expr_list_node(args.items, args.count);
+  free(args.items);
+
+  return expr_list_node;
 }
 
-ASTnode *parse_arith_exp_impl(const GrammarRule *rule,
-                              Symbol *callee_function_symbol) {
+ASTnode *parse_arith_exp_impl(const GrammarRule *rule) {
   if (!rule->isFirst(rule, currentToken)) {
     report_error(rule->name, "token not in arith_exp first set");
     exit(1);
   }
 
+  // Check for a function call used as a value
+  if (currentToken.type == TOKEN_ID && peekToken().type == TOKEN_LPAREN) {
+    debug("arith_exp calls fn_call");
+    const GrammarRule *fn_call = get_rule("fn_call");
+    return parse_call_exp(fn_call);
+  }
+
   // Check for ID
   if (currentToken.type == TOKEN_ID) {
     char *id = capture_identifier();
-    Symbol *found_symbol = NULL;
-
-    Symbol *current_defining_function_symbol = NULL;
-    if (currentScope && currentScope->parent) {
-      Symbol *sym_in_parent = currentScope->parent->symbols;
-      while (sym_in_parent != NULL) {
-        if (sym_in_parent->type &&
-            strcmp(sym_in_parent->type, "function") == 0) {
-          current_defining_function_symbol = sym_in_parent;
-          break;
-        }
-        sym_in_parent = sym_in_parent->next;
-      }
-    }
-
-    if (current_defining_function_symbol != NULL) {
-      Symbol *formal = current_defining_function_symbol->arguments;
-      while (formal != NULL) {
-        if (strcmp(formal->name, id) == 0) {
-          found_symbol = formal;
-          break;
-        }
-        formal = formal->next;
-      }
-    }
-
-    if (found_symbol == NULL) {
-      found_symbol = lookup_symbol_in_table(id, "variable");
-    }
+    Symbol *found_symbol = lookup_variable_in_table(id);
 
     if (found_symbol == NULL) {
       report_error(rule->name, "could not find ID (parameter or variable)");
@@ -630,21 +867,6 @@ ASTnode *parse_arith_exp_impl(const GrammarRule *rule,
       exit(1);
     }
 
-    if (callee_function_symbol != NULL) {
-      int number_of_args = callee_function_symbol->number_of_arguments;
-      if (chk_decl_flag && number_of_args <= 0 &&
-          strcmp(callee_function_symbol->name, "println") != 0) {
-        report_error(rule->name,
-                     "too many arguments provided in function call");
-        free(id);
-        exit(1);
-      }
-
-      if (strcmp(callee_function_symbol->name, "println") != 0) {
-        callee_function_symbol->number_of_arguments = number_of_args - 1;
-      }
-    }
-
     free(id);
     debug("return id node");
     return create_identifier_node(found_symbol);
@@ -655,18 +877,6 @@ ASTnode *parse_arith_exp_impl(const GrammarRule *rule,
       exit(1);
     }
 
-    if (callee_function_symbol != NULL) {
-      int number_of_args = callee_function_symbol->number_of_arguments;
-      if (chk_decl_flag && number_of_args <= 0 &&
-          strcmp(callee_function_symbol->name, "println") != 0) {
-        report_error(rule->name, "too many arguments provided (constant)");
-        exit(1);
-      }
-      if (strcmp(callee_function_symbol->name, "println") != 0) {
-        callee_function_symbol->number_of_arguments = number_of_args - 1;
-      }
-    }
-
     debug("return intconst node");
     int number = 0;
     number = atoi(currentToken.lexeme);
@@ -758,6 +968,7 @@ ASTnode *parse_if_stmt_impl(const GrammarRule *rule) {
   return create_if_node(bool_node, stmt_node, else_node);
 }
 
+// bool_exp : bool_term { opOR bool_term }
 ASTnode *parse_bool_exp_impl(const GrammarRule *rule) {
   // Check first
   if (!rule->isFirst(rule, currentToken)) {
@@ -765,26 +976,91 @@ ASTnode *parse_bool_exp_impl(const GrammarRule *rule) {
     exit(1);
   }
 
+  debug("bool_exp calls bool_term");
+  const GrammarRule *bool_term = get_rule("bool_term");
+  ASTnode *bool_node = bool_term->parse(bool_term);
+
+  // || is left associative
+  while (match(TOKEN_OPOR)) {
+    debug("bool_exp calls bool_term");
+    ASTnode *rhs_node = bool_term->parse(bool_term);
+    bool_node = create_or_node(bool_node, rhs_node);
+  }
+
+  return bool_node;
+}
+
+// bool_term : bool_factor { opAND bool_factor }
+ASTnode *parse_bool_term_impl(const GrammarRule *rule) {
+  if (!rule->isFirst(rule, currentToken)) {
+    report_error(rule->name, "unexpected token in bool_term");
+    exit(1);
+  }
+
+  debug("bool_term calls bool_factor");
+  const GrammarRule *bool_factor = get_rule("bool_factor");
+  ASTnode *bool_node = bool_factor->parse(bool_factor);
+
+  // && binds tighter than || and is also left associative
+  while (match(TOKEN_OPAND)) {
+    debug("bool_term calls bool_factor");
+    ASTnode *rhs_node = bool_factor->parse(bool_factor);
+    bool_node = create_and_node(bool_node, rhs_node);
+  }
+
+  return bool_node;
+}
+
+// bool_factor : opNOT bool_factor
+//             | LPAREN bool_exp RPAREN
+//             | arith_exp relop arith_exp
+ASTnode *parse_bool_factor_impl(const GrammarRule *rule) {
+  if (!rule->isFirst(rule, currentToken)) {
+    report_error(rule->name, "unexpected token in bool_factor");
+    exit(1);
+  }
+
+  // Parse opNOT
+  if (match(TOKEN_OPNOT)) {
+    debug("bool_factor calls bool_factor");
+    ASTnode *operand_node = rule->parse(rule);
+    return create_not_node(operand_node);
+  }
+
+  // Parse LPAREN bool_exp RPAREN
+  if (match(TOKEN_LPAREN)) {
+    debug("bool_factor calls bool_exp");
+    const GrammarRule *bool_exp = get_rule("bool_exp");
+    ASTnode *bool_node = bool_exp->parse(bool_exp);
+
+    if (!match(TOKEN_RPAREN)) {
+      report_error(rule->name, "expected RPAREN");
+      exit(1);
+    }
+    return bool_node;
+  }
+
   // Parse arith_exp
   debug("bool calling arith");
   const GrammarRule *arith_exp = get_rule("arith_exp");
-  ASTnode *lhs_node = arith_exp->parseEx(arith_exp, NULL);
+  ASTnode *lhs_node = arith_exp->parse(arith_exp);
 
   // Parse relop
   debug("bool calling relop");
   const GrammarRule *relop = get_rule("relop");
-  ASTnode *bool_node = relop->parse(relop);
+  NodeType relop_type = parse_relop_type(relop);
 
   // Parse arith_exp
   debug("bool calling arith");
-  ASTnode *rhs_node = arith_exp->parseEx(arith_exp, NULL);
+  ASTnode *rhs_node = arith_exp->parse(arith_exp);
 
-  bool_node->child0 = lhs_node;
-  bool_node->child1 = rhs_node;
-  return bool_node;
+  return create_relop_node(relop_type, lhs_node, rhs_node);
 }
 
-ASTnode *parse_relop_impl(const GrammarRule *rule) {
+// Matches a relational operator and returns the node type for it. The
+// comparison node is only built once both operands are known, so that nodes
+// never change after they are made.
+static NodeType parse_relop_type(const GrammarRule *rule) {
   debug("parse_relop_impl");
   const GrammarRule *relop = get_rule("relop");
   // Check first
@@ -795,56 +1071,54 @@ ASTnode *parse_relop_impl(const GrammarRule *rule) {
 
   if (match(TOKEN_OPEQ)) {
     debug("EQ");
-    return create_eq_node(NULL, NULL);
+    return EQ;
   }
 
   if (match(TOKEN_OPNE)) {
     debug("NE");
-    return create_ne_node(NULL, NULL);
+    return NE;
   }
 
   if (match(TOKEN_OPLE)) {
     debug("LE");
-    return create_le_node(NULL, NULL);
+    return LE;
   }
 
   if (match(TOKEN_OPLT)) {
     debug("LT");
-    return create_lt_node(NULL, NULL);
+    return LT;
   }
 
   if (match(TOKEN_OPGE)) {
     debug("GE");
-    return create_ge_node(NULL, NULL);
+    return GE;
   }
 
   if (match(TOKEN_OPGT)) {
     debug("GT");
-    return create_gt_node(NULL, NULL);
+    return GT;
   }
 
   report_error(rule->name, "unexpected token in relop");
   exit(1);
 }
 
+ASTnode *parse_relop_impl(const GrammarRule *rule) {
+  return create_relop_node(parse_relop_type(rule), NULL, NULL);
+}
+
 ASTnode *parse_assg_stmt_impl(const GrammarRule *rule) {
   // Parse ID
   char *id = capture_identifier();
 
   // Lookup
-  if (!lookup(id, "variable")) {
+  Symbol *id_name = lookup_variable_in_table(id);
+  if (id_name == NULL) {
     report_error(rule->name, "ID does not exist");
     free(id);
     exit(1);
   }
 
-  Symbol *id_name = lookup_symbol_in_table(id, "variable");
-
-  if (id_name == NULL) {
-    report_error(rule->name, "Could not find symbol");
-    exit(1);
-  }
-
   assert(strlen(id_name->name) != 0);
 
   ASTnode *identifier = create_identifier_node(id_name);
@@ -859,7 +1133,7 @@ ASTnode *parse_assg_stmt_impl(const GrammarRule *rule) {
   // parse arith_exp
   debug("assg_stmt calls arith_exp");
   const GrammarRule *arith_exp = get_rule("arith_exp");
-  ASTnode *arith_node = arith_exp->parseEx(arith_exp, NULL);
+  ASTnode *arith_node = arith_exp->parse(arith_exp);
 
   // parse SEMI
   if (!match(TOKEN_SEMI)) {
@@ -889,7 +1163,7 @@ ASTnode *parse_return_stmt_impl(const GrammarRule *rule) {
   if (arith_exp->isFirst(arith_exp, currentToken)) {
     // parse arith_exp
     debug("return calls arith_exp");
-    arith_node = arith_exp->parseEx(arith_exp, NULL);
+    arith_node = arith_exp->parse(arith_exp);
   }
 
   // parse semi
@@ -943,7 +1217,7 @@ ASTnode *parse_id_list_impl(const GrammarRule *rule) {
 
   // parse ID
   char *id = capture_identifier();
-  if (!add_symbol_check(id, "variable")) {
+  if (!add_symbol_check(id, SYMBOL_VARIABLE)) {
     report_error(rule->name, "token is ID but couldn't get name from lexeme");
     free(id);
     exit(1);
@@ -965,7 +1239,12 @@ void init_grammar_rules(void) {
   const TokenType arith_exp_first[] = {TOKEN_ID, TOKEN_INTCON};
   const TokenType assg_or_fn_first[] = {TOKEN_OPASSG, TOKEN_LPAREN};
   const TokenType assg_stmt_first[] = {TOKEN_OPASSG};
-  const TokenType bool_exp_first[] = {TOKEN_ID, TOKEN_INTCON};
+  const TokenType bool_exp_first[] = {TOKEN_ID, TOKEN_INTCON, TOKEN_LPAREN,
+                                      TOKEN_OPNOT};
+  const TokenType bool_term_first[] = {TOKEN_ID, TOKEN_INTCON, TOKEN_LPAREN,
+                                       TOKEN_OPNOT};
+  const TokenType bool_factor_first[] = {TOKEN_ID, TOKEN_INTCON, TOKEN_LPAREN,
+                                         TOKEN_OPNOT};
   const TokenType decl_or_func_first[] = {TOKEN_COMMA, TOKEN_LPAREN,
                                           TOKEN_SEMI};
   const TokenType expr_list_first[] = {TOKEN_ID, TOKEN_INTCON};
@@ -991,9 +1270,9 @@ void init_grammar_rules(void) {
   const TokenType while_stmt_first[] = {TOKEN_KWWHILE};
 
   // FOLLOW sets
-  const TokenType arith_exp_follow[] = {TOKEN_SEMI, TOKEN_OPEQ,  TOKEN_OPNE,
-                                        TOKEN_OPLE, TOKEN_OPLT,  TOKEN_OPGE,
-                                        TOKEN_OPGT, TOKEN_COMMA, TOKEN_RPAREN};
+  const TokenType arith_exp_follow[] = {
+      TOKEN_SEMI, TOKEN_OPEQ,  TOKEN_OPNE,   TOKEN_OPLE,  TOKEN_OPLT, TOKEN_OPGE,
+      TOKEN_OPGT, TOKEN_COMMA, TOKEN_RPAREN, TOKEN_OPAND, TOKEN_OPOR};
   const TokenType assg_or_fn_follow[] = {
       TOKEN_KWELSE, TOKEN_ID,   TOKEN_KWIF,    TOKEN_KWRETURN,
       TOKEN_LBRACE, TOKEN_SEMI, TOKEN_KWWHILE, TOKEN_RBRACE};
@@ -1001,6 +1280,9 @@ void init_grammar_rules(void) {
       TOKEN_KWELSE, TOKEN_ID,   TOKEN_KWIF,    TOKEN_KWRETURN,
       TOKEN_LBRACE, TOKEN_SEMI, TOKEN_KWWHILE, TOKEN_RBRACE};
   const TokenType bool_exp_follow[] = {TOKEN_RPAREN};
+  const TokenType bool_term_follow[] = {TOKEN_OPOR, TOKEN_RPAREN};
+  const TokenType bool_factor_follow[] = {TOKEN_OPAND, TOKEN_OPOR,
+                                          TOKEN_RPAREN};
   const TokenType decl_or_func_follow[] = {TOKEN_KWINT, TOKEN_EOF};
   const TokenType expr_list_follow[] = {TOKEN_RPAREN};
   const TokenType fn_call_follow[] = {TOKEN_KWELSE,   TOKEN_ID,     TOKEN_KWIF,
@@ -1037,18 +1319,22 @@ void init_grammar_rules(void) {
   // Create rules with their parsing functions
   create_rule("prog", prog_first, 1, prog_follow, 1, parse_prog_impl, false);
   create_rule("type", type_first, 1, type_follow, 1, parse_type_impl, false);
-  create_rule("arith_exp", arith_exp_first, 2, arith_exp_follow, 9,
-              parse_arith_exp_impl, true);
+  create_rule("arith_exp", arith_exp_first, 2, arith_exp_follow, 11,
+              parse_arith_exp_impl, false);
   create_rule("assg_or_fn", assg_or_fn_first, 2, assg_or_fn_follow, 8,
               parse_assg_or_fn_impl, false);
   create_rule("assg_stmt", assg_stmt_first, 1, assg_stmt_follow, 8,
               parse_assg_stmt_impl, false);
-  create_rule("bool_exp", bool_exp_first, 2, bool_exp_follow, 1,
+  create_rule("bool_exp", bool_exp_first, 4, bool_exp_follow, 1,
               parse_bool_exp_impl, false);
+  create_rule("bool_term", bool_term_first, 4, bool_term_follow, 2,
+              parse_bool_term_impl, false);
+  create_rule("bool_factor", bool_factor_first, 4, bool_factor_follow, 3,
+              parse_bool_factor_impl, false);
   create_rule("decl_or_func", decl_or_func_first, 3, decl_or_func_follow, 0,
               parse_decl_or_func_impl, false);
   create_rule("expr_list", expr_list_first, 2, expr_list_follow, 1,
-              parse_expr_list_impl, true);
+              parse_expr_list_impl, false);
   create_rule("fn_call", fn_call_first, 1, fn_call_follow, 8,
               parse_fn_call_impl, false);
   create_rule("formals", formals_first, 1, formals_follow, 1,
@@ -1060,7 +1346,7 @@ void init_grammar_rules(void) {
   create_rule("if_stmt", if_stmt_first, 1, if_stmt_follow, 8,
               parse_if_stmt_impl, false);
   create_rule("opt_expr_list", opt_expr_list_first, 2, opt_expr_list_follow, 1,
-              parse_opt_expr_list_impl, true);
+              parse_opt_expr_list_impl, false);
   create_rule("opt_formals", opt_formals_first, 1, opt_formals_follow, 1,
               parse_opt_formals_impl, false);
   create_rule("opt_stmt_list", opt_stmt_list_first, 6, opt_stmt_list_follow, 1,
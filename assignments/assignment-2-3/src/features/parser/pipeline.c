@@ -0,0 +1,222 @@
+// pipeline.c
+#include "pipeline.h"
+#include "mips.h"
+#include "symbol_table.h"
+#include "tac.h"
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+typedef struct {
+  void *func_def;
+  ASTArena *arena;
+  ASTStore *store; // set when func_def is a compact store handle
+  ASTArena *symbol_arena;
+  size_t sequence; // Position of the function in the source
+} PipelineJob;
+
+typedef struct {
+  char *mips_text;
+  bool main_exists;
+  bool println_used;
+} FunctionResult;
+
+// Single-producer single-consumer ring buffer. Only the parser writes
+// queue_tail and only the worker writes queue_head, so the stores and loads
+// of the two indices are all the synchronization the slots need.
+static PipelineJob queue[PIPELINE_QUEUE_SIZE];
+static atomic_size_t queue_head = 0; // Next slot the worker takes
+static atomic_size_t queue_tail = 0; // Next slot the parser fills
+static atomic_bool parsing_done = false;
+
+// A side that has to wait polls the ring a bounded number of times, then
+// sleeps on queue_changed. Whoever moves the ring broadcasts only when
+// someone sleeps. The indices, the done flag and sleepers are all accessed
+// sequentially consistently: a waiter either is counted before the other
+// side checks sleepers, or sees the other side's store when it checks the
+// ring again under the lock.
+#define PIPELINE_SPIN_LIMIT 200
+static pthread_mutex_t queue_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t queue_changed = PTHREAD_COND_INITIALIZER;
+static atomic_int sleepers = 0;
+
+static size_t submitted_count = 0;
+
+// Owned by the worker until pipeline_finish() joins it
+static FunctionResult *results = NULL;
+static size_t result_capacity = 0;
+
+static pthread_t backend_thread;
+
+static void store_result(size_t sequence, FunctionResult result) {
+  if (sequence >= result_capacity) {
+    size_t new_capacity = (result_capacity == 0) ? 16 : result_capacity * 2;
+    while (new_capacity <= sequence) {
+      new_capacity *= 2;
+    }
+    FunctionResult *new_results =
+        realloc(results, new_capacity * sizeof(FunctionResult));
+    if (!new_results) {
+      fprintf(stderr, "ERROR: Memory allocation failed\n");
+      exit(1);
+    }
+    results = new_results;
+    result_capacity = new_capacity;
+  }
+  results[sequence] = result;
+}
+
+// Lowers one function all the way to MIPS text
+static void compile_function(PipelineJob job) {
+  FunctionResult result = {NULL, false, false};
+  Quad *code_list = NULL;
+
+  // The quads and spill slots go with the function's symbols
+  ASTArena *previous_tac_arena = tac_use_arena(job.symbol_arena);
+  ast_store_bind(job.store);
+  make_TAC(job.func_def, &code_list);
+  ast_store_bind(NULL);
+  tac_use_arena(previous_tac_arena);
+  ast_arena_destroy(job.arena);
+  ast_store_destroy(job.store);
+  Quad *tac_list = reverse_tac_list(code_list);
+
+  scan_tac_features(tac_list, &result.main_exists, &result.println_used);
+
+  MipsInstruction *mips_list = generate_mips_text(tac_list);
+  result.mips_text = mips_list_to_string(mips_list);
+  free_mips_list(mips_list);
+  ast_arena_destroy(job.symbol_arena);
+
+  store_result(job.sequence, result);
+}
+
+static bool job_or_done(void) {
+  return atomic_load(&queue_head) != atomic_load(&queue_tail) ||
+         atomic_load(&parsing_done);
+}
+
+static bool slot_free(void) {
+  return atomic_load(&queue_tail) - atomic_load(&queue_head) <
+         PIPELINE_QUEUE_SIZE;
+}
+
+static void wait_until(bool (*ready)(void)) {
+  for (int spins = 0; spins < PIPELINE_SPIN_LIMIT; spins++) {
+    if (ready()) {
+      return;
+    }
+    sched_yield();
+  }
+
+  pthread_mutex_lock(&queue_lock);
+  atomic_fetch_add(&sleepers, 1);
+  while (!ready()) {
+    pthread_cond_wait(&queue_changed, &queue_lock);
+  }
+  atomic_fetch_sub(&sleepers, 1);
+  pthread_mutex_unlock(&queue_lock);
+}
+
+// Called after moving the ring, to wake the other side if it is asleep
+static void notify_queue_changed(void) {
+  if (atomic_load(&sleepers) > 0) {
+    pthread_mutex_lock(&queue_lock);
+    pthread_cond_broadcast(&queue_changed);
+    pthread_mutex_unlock(&queue_lock);
+  }
+}
+
+static void *backend_worker(void *arg) {
+  (void)arg;
+
+  while (true) {
+    wait_until(job_or_done);
+
+    // The done flag is set after the last tail update, so if the queue is
+    // still empty once done is seen, nothing else is coming
+    size_t head = atomic_load_explicit(&queue_head, memory_order_relaxed);
+    if (head == atomic_load(&queue_tail)) {
+      break;
+    }
+
+    PipelineJob job = queue[head % PIPELINE_QUEUE_SIZE];
+    atomic_store(&queue_head, head + 1);
+    notify_queue_changed();
+
+    compile_function(job);
+  }
+
+  return NULL;
+}
+
+void pipeline_start(void) {
+  atomic_store(&queue_head, 0);
+  atomic_store(&queue_tail, 0);
+  atomic_store(&parsing_done, false);
+  submitted_count = 0;
+
+  if (pthread_create(&backend_thread, NULL, backend_worker, NULL) != 0) {
+    fprintf(stderr, "ERROR: could not start the backend thread\n");
+    exit(1);
+  }
+}
+
+// Called by the parser once a function and its scope are complete. Nothing
+// reachable from func_def may change after this.
+void pipeline_submit(void *func_def, ASTArena *arena, ASTStore *store,
+                     ASTArena *symbol_arena) {
+  // Wait while the ring is full
+  wait_until(slot_free);
+  size_t tail = atomic_load_explicit(&queue_tail, memory_order_relaxed);
+
+  queue[tail % PIPELINE_QUEUE_SIZE].func_def = func_def;
+  queue[tail % PIPELINE_QUEUE_SIZE].arena = arena;
+  queue[tail % PIPELINE_QUEUE_SIZE].store = store;
+  queue[tail % PIPELINE_QUEUE_SIZE].symbol_arena = symbol_arena;
+  queue[tail % PIPELINE_QUEUE_SIZE].sequence = submitted_count++;
+  atomic_store(&queue_tail, tail + 1);
+  notify_queue_changed();
+}
+
+// Waits for the backend, then prints the globals, the functions in source
+// order and the runtime, the same as the sequential path
+void pipeline_finish(void) {
+  atomic_store(&parsing_done, true);
+  notify_queue_changed();
+
+  if (pthread_join(backend_thread, NULL) != 0) {
+    fprintf(stderr, "ERROR: could not join the backend thread\n");
+    exit(1);
+  }
+
+  bool main_exists = false;
+  bool println_used = false;
+
+  MipsInstruction *data_list = generate_mips_data();
+  char *data_text = mips_list_to_string(data_list);
+  printf("%s.text\n", data_text);
+  free(data_text);
+  free_mips_list(data_list);
+
+  for (size_t i = 0; i < submitted_count; i++) {
+    printf("%s", results[i].mips_text);
+    main_exists = main_exists || results[i].main_exists;
+    println_used = println_used || results[i].println_used;
+    free(results[i].mips_text);
+  }
+
+  MipsInstruction *runtime_list =
+      generate_mips_runtime(println_used, main_exists);
+  char *runtime_text = mips_list_to_string(runtime_list);
+  printf("%s", runtime_text);
+  free(runtime_text);
+  free_mips_list(runtime_list);
+
+  free(results);
+  results = NULL;
+  result_capacity = 0;
+}
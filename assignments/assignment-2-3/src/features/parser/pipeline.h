@@ -0,0 +1,21 @@
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include "ast.h"
+#include "ast_store.h"
+
+// Number of parsed functions that can wait for the backend before the
+// parser has to stop and let it catch up
+#define PIPELINE_QUEUE_SIZE 64
+
+// Overlaps parsing with code generation. The parser thread hands each
+// finished FUNC_DEF to pipeline_submit(), a backend worker lowers it to TAC
+// and MIPS, and pipeline_finish() prints the whole program in source order.
+// The arena or compact store holding each submitted tree, and the arena
+// holding its function's symbols, are destroyed by the backend.
+void pipeline_start(void);
+void pipeline_submit(void *func_def, ASTArena *arena, ASTStore *store,
+                     ASTArena *symbol_arena);
+void pipeline_finish(void);
+
+#endif
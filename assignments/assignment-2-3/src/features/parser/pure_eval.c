@@ -0,0 +1,435 @@
+// pure_eval.c
+#include "pure_eval.h"
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Each evaluated call nests a few C calls, so recursion is bounded as well
+#define PURE_EVAL_MAX_DEPTH 200
+
+typedef struct {
+  Symbol *function;
+  ASTnode *body;
+} PureFunction;
+
+static PureFunction *functions = NULL;
+static int function_count = 0;
+static int function_capacity = 0;
+
+// From function symbol to index in functions
+static SymbolIndex function_table = {0};
+
+// Holds the copies of the pure functions' bodies
+static ASTArena *pure_arena = NULL;
+
+// Parameters and locals of the calls being evaluated, innermost call last,
+// found by name
+typedef struct {
+  const char *name;
+  int value;
+} Variable;
+
+static Variable *variables = NULL;
+static int variable_count = 0;
+static int variable_capacity = 0;
+
+// State of the evaluation in progress
+static int steps = 0;
+static int depth = 0;
+static bool failed = false;
+static int return_value = 0;
+static bool returned_value = false;
+
+/*******************************************************************************
+ *                                                                             *
+ *                               PURE FUNCTIONS                                *
+ *                                                                             *
+ *******************************************************************************/
+
+static const PureFunction *find_function(const Symbol *function) {
+  int index = symbol_index_get(&function_table, function);
+  return (index >= 0) ? &functions[index] : NULL;
+}
+
+// A tree is pure if it names no global and calls only pure functions or self
+static bool is_pure(ASTnode *node, const Symbol *self) {
+  if (node == NULL) {
+    return true;
+  }
+
+  if (node->node_type == STMT_LIST || node->node_type == EXPR_LIST) {
+    for (int i = 0; i < node->count; i++) {
+      if (!is_pure(node->items[i], self)) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  if (node->node_type == IDENTIFIER && (node->symbol->flags & SYMBOL_GLOBAL)) {
+    return false;
+  }
+  if (node->node_type == FUNC_CALL && node->symbol != self &&
+      find_function(node->symbol) == NULL) {
+    return false;
+  }
+
+  return is_pure(node->child0, self) && is_pure(node->child1, self) &&
+         is_pure(node->child2, self);
+}
+
+void pure_eval_register(ASTnode *func_def) {
+  Symbol *function = func_def->symbol;
+  if (!is_pure(func_def->child0, function)) {
+    return;
+  }
+
+  if (pure_arena == NULL) {
+    pure_arena = ast_arena_create();
+  }
+  if (function_count == function_capacity) {
+    function_capacity = (function_capacity == 0) ? 16 : function_capacity * 2;
+    functions =
+        checked_realloc(functions, function_capacity * sizeof(PureFunction));
+  }
+
+  ASTArena *previous_arena = ast_arena_use(pure_arena);
+  functions[function_count].function = function;
+  functions[function_count].body =
+      ast_copy(func_def->child0, ast_keep_symbol, NULL);
+  ast_arena_use(previous_arena);
+
+  symbol_index_put(&function_table, function, function_count);
+  function_count++;
+}
+
+void pure_eval_reset(void) {
+  ast_arena_destroy(pure_arena);
+  pure_arena = NULL;
+  free(functions);
+  functions = NULL;
+  function_count = 0;
+  function_capacity = 0;
+  symbol_index_free(&function_table);
+  free(variables);
+  variables = NULL;
+  variable_count = 0;
+  variable_capacity = 0;
+}
+
+/*******************************************************************************
+ *                                                                             *
+ *                                 EVALUATION                                  *
+ *                                                                             *
+ *******************************************************************************/
+
+static int eval(ASTnode *expr, int base);
+static bool exec(ASTnode *stmt, int base);
+
+static bool take_step(void) {
+  if (!failed && ++steps > PURE_EVAL_STEP_LIMIT) {
+    failed = true;
+  }
+  return !failed;
+}
+
+// Looks in the frame that starts at base, the innermost one
+static Variable *find_variable(const char *name, int base) {
+  for (int i = variable_count - 1; i >= base; i--) {
+    if (strcmp(variables[i].name, name) == 0) {
+      return &variables[i];
+    }
+  }
+  return NULL;
+}
+
+static void set_variable(const char *name, int value, int base) {
+  Variable *variable = find_variable(name, base);
+  if (variable != NULL) {
+    variable->value = value;
+    return;
+  }
+
+  if (variable_count == variable_capacity) {
+    variable_capacity = (variable_capacity == 0) ? 64 : variable_capacity * 2;
+    variables =
+        checked_realloc(variables, variable_capacity * sizeof(Variable));
+  }
+  variables[variable_count].name = name;
+  variables[variable_count].value = value;
+  variable_count++;
+}
+
+// value_needed is false for a call that is a statement of its own, which may
+// end without returning anything
+static int call(ASTnode *call_node, int base, bool value_needed) {
+  const PureFunction *callee = find_function(call_node->symbol);
+  ASTnode *args = call_node->child0;
+  int nargs = (args != NULL) ? args->count : 0;
+  if (callee == NULL || depth == PURE_EVAL_MAX_DEPTH ||
+      nargs != callee->function->number_of_arguments) {
+    failed = true;
+    return 0;
+  }
+
+  // All arguments are worked out before the callee's frame is started, so
+  // they cannot see its parameters
+  int small_values[8];
+  int *values = small_values;
+  if (nargs > 8) {
+    values = malloc(nargs * sizeof(int));
+    if (!values) {
+      fprintf(stderr, "ERROR: Memory allocation failed\n");
+      exit(1);
+    }
+  }
+  for (int i = 0; i < nargs && !failed; i++) {
+    values[i] = eval(args->items[i], base);
+  }
+
+  int callee_base = variable_count;
+  Symbol *formal = callee->function->arguments;
+  for (int i = 0; i < nargs && !failed; i++, formal = formal->next) {
+    set_variable(formal->name, values[i], callee_base);
+  }
+  if (values != small_values) {
+    free(values);
+  }
+
+  depth++;
+  returned_value = false;
+  if (!failed) {
+    exec(callee->body, callee_base);
+  }
+  depth--;
+  variable_count = callee_base;
+
+  if (value_needed && !returned_value) {
+    failed = true;
+  }
+  return return_value;
+}
+
+static int eval(ASTnode *expr, int base) {
+  if (!take_step()) {
+    return 0;
+  }
+
+  switch (expr->node_type) {
+  case INTCONST:
+    return expr->num;
+
+  case IDENTIFIER: {
+    Variable *variable = find_variable(expr->symbol->name, base);
+    if (variable == NULL) {
+      failed = true;
+      return 0;
+    }
+    return variable->value;
+  }
+
+  case FUNC_CALL:
+    return call(expr, base, true);
+
+  case UMINUS:
+    return (int)(0u - (unsigned)eval(expr->child0, base));
+
+  case NOT:
+    return !eval(expr->child0, base);
+
+  case AND:
+    return eval(expr->child0, base) && eval(expr->child1, base);
+
+  case OR:
+    return eval(expr->child0, base) || eval(expr->child1, base);
+
+  default:
+    break;
+  }
+
+  int left = eval(expr->child0, base);
+  int right = eval(expr->child1, base);
+
+  switch (expr->node_type) {
+  case ADD:
+    return (int)((unsigned)left + (unsigned)right);
+  case SUB:
+    return (int)((unsigned)left - (unsigned)right);
+  case MUL:
+    return (int)((unsigned)left * (unsigned)right);
+  case DIV:
+    // Left to run, as constant folding does
+    if (right == 0 || (left == INT_MIN && right == -1)) {
+      failed = true;
+      return 0;
+    }
+    return left / right;
+  case EQ:
+    return left == right;
+  case NE:
+    return left != right;
+  case LE:
+    return left <= right;
+  case LT:
+    return left < right;
+  case GE:
+    return left >= right;
+  case GT:
+    return left > right;
+  default:
+    failed = true;
+    return 0;
+  }
+}
+
+// Returns true once a return has run or the evaluation has failed
+static bool exec(ASTnode *stmt, int base) {
+  if (stmt == NULL) {
+    return false;
+  }
+  if (!take_step()) {
+    return true;
+  }
+
+  switch (stmt->node_type) {
+  case STMT_LIST:
+    for (int i = 0; i < stmt->count; i++) {
+      if (exec(stmt->items[i], base)) {
+        return true;
+      }
+    }
+    return false;
+
+  case ASSG: {
+    int value = eval(stmt->child1, base);
+    set_variable(stmt->child0->symbol->name, value, base);
+    return failed;
+  }
+
+  case FUNC_CALL:
+    call(stmt, base, false);
+    return failed;
+
+  case IF: {
+    int condition = eval(stmt->child0, base);
+    if (failed) {
+      return true;
+    }
+    return exec(condition ? stmt->child1 : stmt->child2, base);
+  }
+
+  case WHILE:
+    while (true) {
+      int condition = eval(stmt->child0, base);
+      if (failed) {
+        return true;
+      }
+      if (!condition) {
+        return false;
+      }
+      if (exec(stmt->child1, base)) {
+        return true;
+      }
+    }
+
+  case RETURN:
+    returned_value = (stmt->child0 != NULL);
+    return_value = returned_value ? eval(stmt->child0, base) : 0;
+    return true;
+
+  default:
+    failed = true;
+    return true;
+  }
+}
+
+/*******************************************************************************
+ *                                                                             *
+ *                                 CALL SITES                                  *
+ *                                                                             *
+ *******************************************************************************/
+
+// The node is reused as the constant, as constant folding does
+static void try_eval_call(ASTnode *call_node) {
+  if (find_function(call_node->symbol) == NULL) {
+    return;
+  }
+  ASTnode *args = call_node->child0;
+  int nargs = (args != NULL) ? args->count : 0;
+  for (int i = 0; i < nargs; i++) {
+    if (args->items[i] == NULL || args->items[i]->node_type != INTCONST) {
+      return;
+    }
+  }
+
+  steps = 0;
+  depth = 0;
+  failed = false;
+  variable_count = 0;
+  int value = call(call_node, 0, true);
+  if (failed) {
+    return;
+  }
+
+  call_node->node_type = INTCONST;
+  call_node->num = value;
+  call_node->child0 = NULL;
+}
+
+// Inner calls go first, so their values can make outer arguments constant.
+// A shared node has no call below it.
+static void eval_calls_in_expr(ASTnode *expr) {
+  if (expr == NULL || expr->shared) {
+    return;
+  }
+
+  if (expr->node_type == EXPR_LIST) {
+    for (int i = 0; i < expr->count; i++) {
+      eval_calls_in_expr(expr->items[i]);
+    }
+    return;
+  }
+
+  eval_calls_in_expr(expr->child0);
+  eval_calls_in_expr(expr->child1);
+  if (expr->node_type == FUNC_CALL) {
+    try_eval_call(expr);
+  }
+}
+
+static void eval_calls_in_stmt(ASTnode *stmt) {
+  if (stmt == NULL) {
+    return;
+  }
+
+  switch (stmt->node_type) {
+  case STMT_LIST:
+    for (int i = 0; i < stmt->count; i++) {
+      eval_calls_in_stmt(stmt->items[i]);
+    }
+    break;
+  case IF:
+    eval_calls_in_expr(stmt->child0);
+    eval_calls_in_stmt(stmt->child1);
+    eval_calls_in_stmt(stmt->child2);
+    break;
+  case WHILE:
+    eval_calls_in_expr(stmt->child0);
+    eval_calls_in_stmt(stmt->child1);
+    break;
+  case ASSG:
+    eval_calls_in_expr(stmt->child1);
+    break;
+  case RETURN:
+  case FUNC_CALL:
+    // For a call statement only its arguments
+    eval_calls_in_expr(stmt->child0);
+    break;
+  default:
+    break;
+  }
+}
+
+void pure_eval_calls(ASTnode *func_def) {
+  eval_calls_in_stmt(func_def->child0);
+}
@@ -0,0 +1,28 @@
+#ifndef PURE_EVAL_H
+#define PURE_EVAL_H
+
+#include "ast.h"
+
+// Compile-time evaluation of calls to pure functions. A function is pure if
+// it reads and writes no globals and calls only pure functions or itself, so
+// never println. A call to one with constant arguments always has the same
+// value; pure_eval_calls() works it out and puts an INTCONST in its place.
+// Evaluation gives up, and the call stays, after PURE_EVAL_STEP_LIMIT
+// nodes, on a division by zero or an overflowing quotient, when a local is
+// read before it is set, or when the function ends without returning a value.
+#define PURE_EVAL_STEP_LIMIT 100000
+
+// Replaces the calls with constant arguments to pure functions in the
+// expressions of func_def. Calls that are statements of their own are left
+// alone.
+void pure_eval_calls(ASTnode *func_def);
+
+// Records func_def for the functions that follow if it is pure. The body and
+// its locals are copied, so func_def's arena and symbol arena may be released
+// afterwards.
+void pure_eval_register(ASTnode *func_def);
+
+// Forgets all pure functions
+void pure_eval_reset(void);
+
+#endif
@@ -0,0 +1,59 @@
+// stream.c
+#include "stream.h"
+#include "mips.h"
+#include "tac.h"
+#include <stdbool.h>
+#include <stdio.h>
+
+// Collected over the whole program for the runtime phase
+static bool main_exists = false;
+static bool println_used = false;
+
+void stream_start(void) {
+  main_exists = false;
+  println_used = false;
+  printf(".text\n");
+}
+
+void stream_function(void *func_def, ASTArena *arena, ASTStore *store,
+                     ASTArena *symbol_arena) {
+  // The quads, operands and spill slots of this function share one arena
+  ASTArena *tac_arena = ast_arena_create();
+  ASTArena *previous_tac_arena = tac_use_arena(tac_arena);
+  ASTStore *previous_store = ast_store_bind(store);
+
+  Quad *code_list = NULL;
+  make_TAC(func_def, &code_list);
+
+  ast_store_bind(previous_store);
+  tac_use_arena(previous_tac_arena);
+  ast_arena_destroy(arena);
+  ast_store_destroy(store);
+
+  Quad *tac_list = reverse_tac_list(code_list);
+
+  bool function_is_main = false;
+  bool function_calls_println = false;
+  scan_tac_features(tac_list, &function_is_main, &function_calls_println);
+  main_exists = main_exists || function_is_main;
+  println_used = println_used || function_calls_println;
+
+  MipsInstruction *mips_list = generate_mips_text(tac_list);
+  ast_arena_destroy(tac_arena);
+  ast_arena_destroy(symbol_arena);
+
+  print_mips_list(mips_list, stdout);
+  free_mips_list(mips_list);
+}
+
+void stream_finish(void) {
+  MipsInstruction *runtime_list =
+      generate_mips_runtime(println_used, main_exists);
+  print_mips_list(runtime_list, stdout);
+  free_mips_list(runtime_list);
+
+  // Globals can be declared after the last function, so they go last
+  MipsInstruction *data_list = generate_mips_data();
+  print_mips_list(data_list, stdout);
+  free_mips_list(data_list);
+}
@@ -0,0 +1,19 @@
+#ifndef STREAM_H
+#define STREAM_H
+
+#include "ast.h"
+#include "ast_store.h"
+
+// Emits each function's MIPS as soon as the parser has finished it and then
+// frees everything made for it, so memory use is bounded by the largest
+// function instead of the whole program. The text segment is written first;
+// the runtime and the globals' data segment follow at the end, once all of
+// them are known. The arena or compact store holding each tree, and the arena
+// holding its function's symbols, are destroyed after the function has been
+// emitted.
+void stream_start(void);
+void stream_function(void *func_def, ASTArena *arena, ASTStore *store,
+                     ASTArena *symbol_arena);
+void stream_finish(void);
+
+#endif
@@ -0,0 +1,254 @@
+// sym_file.c
+#include "sym_file.h"
+#include "symbol_registry.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SYM_FILE_MAGIC "CSYM"
+#define SYM_FILE_VERSION 1
+#define SYM_FILE_BYTE_ORDER 0x01020304u
+
+typedef struct {
+  char magic[4];
+  uint32_t version;
+  uint32_t byte_order;
+  uint32_t file_size;
+
+  uint32_t symbol_count;
+  uint32_t string_bytes;
+  uint32_t symbols_offset;
+  uint32_t strings_offset;
+} SymFileHeader;
+
+typedef struct {
+  uint32_t name; // offset in the string section
+  uint32_t kind; // SYMBOL_FUNCTION or SYMBOL_VARIABLE
+  int32_t number_of_arguments;
+  uint32_t reserved;
+} SymFileSymbol;
+
+static uint32_t align8(uint32_t size) { return (size + 7) & ~(uint32_t)7; }
+
+// Every unit declares println itself
+static bool exported(const Symbol *symbol) {
+  return !(symbol->flags & SYMBOL_EXTERN) &&
+         (symbol->kind == SYMBOL_FUNCTION || symbol->kind == SYMBOL_VARIABLE) &&
+         strcmp(symbol->name, "println") != 0;
+}
+
+/*******************************************************************************
+ *                                                                             *
+ *                                   WRITING                                   *
+ *                                                                             *
+ *******************************************************************************/
+
+bool sym_file_write(const Scope *scope, const char *path) {
+  uint32_t count = 0;
+  uint32_t string_bytes = 0;
+  for (const Symbol *symbol = scope->symbols; symbol; symbol = symbol->next) {
+    if (exported(symbol)) {
+      count++;
+      string_bytes += strlen(symbol->name) + 1;
+    }
+  }
+
+  SymFileHeader header = {0};
+  memcpy(header.magic, SYM_FILE_MAGIC, sizeof(header.magic));
+  header.version = SYM_FILE_VERSION;
+  header.byte_order = SYM_FILE_BYTE_ORDER;
+  header.symbol_count = count;
+  header.string_bytes = string_bytes;
+
+  uint32_t size = align8(sizeof(SymFileHeader));
+  header.symbols_offset = size;
+  size = align8(size + count * sizeof(SymFileSymbol));
+  header.strings_offset = size;
+  size = align8(size + string_bytes);
+  header.file_size = size;
+
+  unsigned char *image = calloc(1, size);
+  if (!image) {
+    fprintf(stderr, "ERROR: Memory allocation failed\n");
+    exit(1);
+  }
+  memcpy(image, &header, sizeof(header));
+
+  // The scope's list is newest first, so it is written from the back
+  SymFileSymbol *records = (SymFileSymbol *)(image + header.symbols_offset);
+  char *strings = (char *)(image + header.strings_offset);
+  uint32_t index = count;
+  uint32_t string_start = string_bytes;
+  for (const Symbol *symbol = scope->symbols; symbol; symbol = symbol->next) {
+    if (!exported(symbol)) {
+      continue;
+    }
+    SymFileSymbol *record = &records[--index];
+    string_start -= strlen(symbol->name) + 1;
+    strcpy(strings + string_start, symbol->name);
+    record->name = string_start;
+    record->kind = symbol->kind;
+    record->number_of_arguments = symbol->number_of_arguments;
+  }
+
+  bool written = false;
+  FILE *file = fopen(path, "wb");
+  if (file) {
+    written = fwrite(image, 1, size, file) == size;
+    written = (fclose(file) == 0) && written;
+  }
+  if (!written) {
+    fprintf(stderr, "ERROR: could not write symbol file %s\n", path);
+  }
+
+  free(image);
+  return written;
+}
+
+/*******************************************************************************
+ *                                                                             *
+ *                                  IMPORTING                                  *
+ *                                                                             *
+ *******************************************************************************/
+
+static bool section_fits(const SymFileHeader *header, uint32_t offset,
+                         uint64_t bytes) {
+  return offset % 8 == 0 && offset >= sizeof(SymFileHeader) &&
+         offset <= header->file_size &&
+         bytes <= header->file_size - offset;
+}
+
+static bool valid_file(const unsigned char *base, size_t size) {
+  if (size < sizeof(SymFileHeader)) {
+    return false;
+  }
+
+  const SymFileHeader *header = (const SymFileHeader *)base;
+  if (memcmp(header->magic, SYM_FILE_MAGIC, 4) != 0 ||
+      header->version != SYM_FILE_VERSION ||
+      header->byte_order != SYM_FILE_BYTE_ORDER ||
+      header->file_size != size ||
+      !section_fits(header, header->symbols_offset,
+                    (uint64_t)header->symbol_count * sizeof(SymFileSymbol)) ||
+      !section_fits(header, header->strings_offset, header->string_bytes)) {
+    return false;
+  }
+
+  // Every name has to end inside the string section
+  const char *strings = (const char *)(base + header->strings_offset);
+  if (header->string_bytes > 0 && strings[header->string_bytes - 1] != '\0') {
+    return false;
+  }
+
+  const SymFileSymbol *records =
+      (const SymFileSymbol *)(base + header->symbols_offset);
+  for (uint32_t i = 0; i < header->symbol_count; i++) {
+    const SymFileSymbol *record = &records[i];
+    if (record->name >= header->string_bytes ||
+        strings[record->name] == '\0' || record->number_of_arguments < 0) {
+      return false;
+    }
+    if (record->kind != SYMBOL_FUNCTION &&
+        !(record->kind == SYMBOL_VARIABLE &&
+          record->number_of_arguments == 0)) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+static unsigned char *read_file(const char *path, size_t *size) {
+  FILE *file = fopen(path, "rb");
+  if (!file) {
+    return NULL;
+  }
+
+  unsigned char *contents = NULL;
+  long length = -1;
+  if (fseek(file, 0, SEEK_END) == 0) {
+    length = ftell(file);
+  }
+  if (length > 0 && fseek(file, 0, SEEK_SET) == 0) {
+    contents = malloc((size_t)length);
+    if (!contents) {
+      fprintf(stderr, "ERROR: Memory allocation failed\n");
+      exit(1);
+    }
+    if (fread(contents, 1, (size_t)length, file) != (size_t)length) {
+      free(contents);
+      contents = NULL;
+    }
+  }
+  fclose(file);
+
+  *size = (size_t)length;
+  return contents;
+}
+
+bool sym_file_import(const char *path) {
+  size_t size = 0;
+  unsigned char *base = read_file(path, &size);
+  if (base == NULL) {
+    fprintf(stderr, "ERROR: could not read symbol file %s\n", path);
+    return false;
+  }
+  if (!valid_file(base, size)) {
+    fprintf(stderr, "ERROR: %s is not a valid symbol file\n", path);
+    free(base);
+    return false;
+  }
+
+  const SymFileHeader *header = (const SymFileHeader *)base;
+  const SymFileSymbol *records =
+      (const SymFileSymbol *)(base + header->symbols_offset);
+  const char *strings = (const char *)(base + header->strings_offset);
+
+  // Imports are declared globally, whatever scope is current
+  Scope *previous_scope = currentScope;
+  currentScope = globalScope;
+
+  bool imported = true;
+  for (uint32_t i = 0; i < header->symbol_count && imported; i++) {
+    const char *name = strings + records[i].name;
+    SymbolKind kind = (SymbolKind)records[i].kind;
+
+    // Units compiled in the same process must agree on every arity
+    if (kind == SYMBOL_FUNCTION) {
+      Symbol function = {0};
+      function.name = (char *)name;
+      function.kind = SYMBOL_FUNCTION;
+      function.number_of_arguments = records[i].number_of_arguments;
+      if (register_function_signature(&function) == NULL) {
+        fprintf(stderr,
+                "ERROR: %s from %s takes %d arguments, but it is registered "
+                "with %d\n",
+                name, path, function.number_of_arguments,
+                lookup_function_signature(name)->number_of_arguments);
+        imported = false;
+        continue;
+      }
+    }
+
+    if (check_duplicate_symbol_in_scope(name, globalScope)) {
+      Symbol *declared = lookup_symbol_in_scope(name, kind, globalScope);
+      if (declared == NULL || declared->number_of_arguments !=
+                                  records[i].number_of_arguments) {
+        fprintf(stderr, "ERROR: %s from %s conflicts with its declaration\n",
+                name, path);
+        imported = false;
+      }
+      continue;
+    }
+
+    add_symbol(name, kind);
+    Symbol *symbol = lookup_symbol_in_scope(name, kind, globalScope);
+    symbol->number_of_arguments = records[i].number_of_arguments;
+    symbol->flags |= SYMBOL_EXTERN;
+  }
+
+  currentScope = previous_scope;
+  free(base);
+  return imported;
+}
@@ -0,0 +1,38 @@
+#ifndef SYM_FILE_H
+#define SYM_FILE_H
+
+#include "symbol_table.h"
+#include <stdbool.h>
+
+/*
+ * Signatures a translation unit exports for separate compilation: its global
+ * variables, and its functions with their arities. Another unit that imports
+ * the file can call the functions and use the variables without the source
+ * that defines them.
+ *
+ *   header   magic "CSYM", version, byte order, file size, counts, and the
+ *            offset of each section
+ *   symbols  symbol_count records in declaration order: name as an offset
+ *            into the string section, kind, and argument count
+ *   strings  NUL-terminated names
+ *
+ * Sections start on 8-byte boundaries. Numbers are in host byte order; the
+ * header records it, and a file from a host with the other order is
+ * rejected.
+ */
+
+// Writes the functions and variables declared in scope, which is the global
+// scope, to path. Imported symbols and println are left out. Returns false,
+// after printing an error, if the file cannot be written.
+bool sym_file_write(const Scope *scope, const char *path);
+
+// Declares the symbols of the file at path in the global scope, flagged
+// SYMBOL_EXTERN. A name that is already declared with the same kind and
+// arity is skipped, so a file can be imported twice. Returns false, after
+// printing an error, for a file that cannot be read or is not well formed,
+// or for a name that is already declared differently. Function signatures
+// also go into the symbol registry, which outlives the symbol table, so a
+// function imported by several units of one process must have one arity.
+bool sym_file_import(const char *path);
+
+#endif
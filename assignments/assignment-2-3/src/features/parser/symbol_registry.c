@@ -0,0 +1,211 @@
+#include "symbol_registry.h"
+#include <assert.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// What a slot points to. Its fields are set before the compare-and-swap that
+// publishes it, and never change afterwards, so a thread that loads the
+// pointer with acquire order can read them without further synchronization.
+typedef struct RegistryEntry {
+  unsigned int hash;
+  const char *name;
+} RegistryEntry;
+
+typedef struct SignatureEntry {
+  RegistryEntry entry;
+  Symbol signature;
+} SignatureEntry;
+
+// A table is a chain of levels, each twice the size of the one before it. A
+// name may only go in the first PROBE_LIMIT slots from its hash in a level.
+// Slots are never emptied, so once those are all taken by other names they
+// stay taken, and the name goes to the next level; the first thread that
+// needs a level that does not exist yet publishes it by compare-and-swap.
+// Threads that look for the same name therefore probe the same slots in the
+// same order and race for the same empty one.
+#define REGISTRY_FIRST_LEVEL 256
+#define REGISTRY_PROBE_LIMIT 8
+
+typedef struct RegistryLevel {
+  _Atomic(struct RegistryLevel *) next;
+  size_t mask;
+  _Atomic(RegistryEntry *) slots[];
+} RegistryLevel;
+
+typedef struct RegistryTable {
+  _Atomic(RegistryLevel *) first;
+  atomic_int count;
+} RegistryTable;
+
+static RegistryTable names;      // entries followed by their name's text
+static RegistryTable signatures; // SignatureEntry
+
+static void *registry_alloc(size_t size) {
+  void *memory = malloc(size);
+  if (!memory) {
+    fprintf(stderr, "ERROR: memory allocation failure\n");
+    exit(1);
+  }
+  return memory;
+}
+
+// The level after level, or the first one when level is NULL. It is created
+// if no thread has done so yet.
+static RegistryLevel *next_level(RegistryTable *table, RegistryLevel *level) {
+  _Atomic(RegistryLevel *) *link = (level != NULL) ? &level->next
+                                                   : &table->first;
+  RegistryLevel *next = atomic_load_explicit(link, memory_order_acquire);
+  if (next != NULL) {
+    return next;
+  }
+
+  size_t size = (level != NULL) ? (level->mask + 1) * 2 : REGISTRY_FIRST_LEVEL;
+  RegistryLevel *created =
+      registry_alloc(sizeof(RegistryLevel) + size * sizeof(created->slots[0]));
+  atomic_init(&created->next, NULL);
+  created->mask = size - 1;
+  for (size_t i = 0; i < size; i++) {
+    atomic_init(&created->slots[i], NULL);
+  }
+
+  // A failed exchange leaves in next the level another thread published
+  if (atomic_compare_exchange_strong_explicit(link, &next, created,
+                                              memory_order_release,
+                                              memory_order_acquire)) {
+    return created;
+  }
+  free(created);
+  return next;
+}
+
+static void table_free(RegistryTable *table) {
+  RegistryLevel *level =
+      atomic_load_explicit(&table->first, memory_order_relaxed);
+  while (level != NULL) {
+    for (size_t i = 0; i <= level->mask; i++) {
+      free(atomic_load_explicit(&level->slots[i], memory_order_relaxed));
+    }
+    RegistryLevel *next =
+        atomic_load_explicit(&level->next, memory_order_relaxed);
+    free(level);
+    level = next;
+  }
+  atomic_store_explicit(&table->first, NULL, memory_order_relaxed);
+  atomic_store_explicit(&table->count, 0, memory_order_relaxed);
+}
+
+static RegistryEntry *table_find(RegistryTable *table, const char *name,
+                                 unsigned int hash) {
+  RegistryLevel *level =
+      atomic_load_explicit(&table->first, memory_order_acquire);
+  for (; level != NULL;
+       level = atomic_load_explicit(&level->next, memory_order_acquire)) {
+    size_t index = hash & level->mask;
+    for (int probes = 0; probes < REGISTRY_PROBE_LIMIT; probes++) {
+      RegistryEntry *entry =
+          atomic_load_explicit(&level->slots[index], memory_order_acquire);
+      if (entry == NULL) {
+        return NULL; // name would have gone here
+      }
+      if (entry->hash == hash && strcmp(entry->name, name) == 0) {
+        return entry;
+      }
+      index = (index + 1) & level->mask;
+    }
+  }
+  return NULL;
+}
+
+// Returns the entry for candidate's name: the one already in table, or
+// candidate itself once it has been published. In the first case the caller
+// still owns candidate.
+static RegistryEntry *table_insert(RegistryTable *table,
+                                   RegistryEntry *candidate) {
+  for (RegistryLevel *level = next_level(table, NULL);;
+       level = next_level(table, level)) {
+    size_t index = candidate->hash & level->mask;
+    for (int probes = 0; probes < REGISTRY_PROBE_LIMIT; probes++) {
+      RegistryEntry *entry =
+          atomic_load_explicit(&level->slots[index], memory_order_acquire);
+      // A failed exchange leaves in entry what another thread published here
+      if (entry == NULL && atomic_compare_exchange_strong_explicit(
+                               &level->slots[index], &entry, candidate,
+                               memory_order_release, memory_order_acquire)) {
+        atomic_fetch_add_explicit(&table->count, 1, memory_order_relaxed);
+        return candidate;
+      }
+      if (entry->hash == candidate->hash &&
+          strcmp(entry->name, candidate->name) == 0) {
+        return entry;
+      }
+      index = (index + 1) & level->mask;
+    }
+  }
+}
+
+void symbol_registry_free(void) {
+  table_free(&signatures);
+  table_free(&names);
+}
+
+const char *intern_name(const char *name) {
+  unsigned int hash = symbol_name_hash(name);
+  RegistryEntry *entry = table_find(&names, name, hash);
+  if (entry != NULL) {
+    return entry->name;
+  }
+
+  size_t size = strlen(name) + 1;
+  RegistryEntry *candidate = registry_alloc(sizeof(RegistryEntry) + size);
+  char *text = (char *)(candidate + 1);
+  memcpy(text, name, size);
+  candidate->hash = hash;
+  candidate->name = text;
+
+  entry = table_insert(&names, candidate);
+  if (entry != candidate) {
+    free(candidate); // Another thread interned name first
+  }
+  return entry->name;
+}
+
+const Symbol *register_function_signature(const Symbol *function) {
+  assert(function->kind == SYMBOL_FUNCTION);
+  const char *name = intern_name(function->name);
+  unsigned int hash = symbol_name_hash(name);
+  RegistryEntry *entry = table_find(&signatures, name, hash);
+
+  if (entry == NULL) {
+    SignatureEntry *candidate = registry_alloc(sizeof(SignatureEntry));
+    memset(&candidate->signature, 0, sizeof(Symbol));
+    candidate->signature.name = (char *)name;
+    candidate->signature.kind = SYMBOL_FUNCTION;
+    candidate->signature.flags = SYMBOL_GLOBAL;
+    candidate->signature.number_of_arguments = function->number_of_arguments;
+    candidate->entry.hash = hash;
+    candidate->entry.name = name;
+
+    entry = table_insert(&signatures, &candidate->entry);
+    if (entry != &candidate->entry) {
+      free(candidate);
+    }
+  }
+
+  const Symbol *signature = &((SignatureEntry *)entry)->signature;
+  if (signature->number_of_arguments != function->number_of_arguments) {
+    return NULL;
+  }
+  return signature;
+}
+
+const Symbol *lookup_function_signature(const char *name) {
+  RegistryEntry *entry =
+      table_find(&signatures, name, symbol_name_hash(name));
+  return (entry != NULL) ? &((SignatureEntry *)entry)->signature : NULL;
+}
+
+int symbol_registry_name_count(void) {
+  return atomic_load_explicit(&names.count, memory_order_relaxed);
+}
@@ -0,0 +1,34 @@
+#ifndef SYMBOL_REGISTRY_H
+#define SYMBOL_REGISTRY_H
+
+#include "symbol_table.h"
+
+// Names and function signatures shared by threads that compile several
+// translation units at once. Both are open-addressing tables whose slots are
+// filled by compare-and-swap, so any number of threads may intern names,
+// register signatures and look them up at the same time without a lock. An
+// entry never changes or moves once it is in a slot. A table that runs out of
+// room gets another level twice its size, so there is no limit to set up
+// front; the registry is empty until the first name goes in.
+//
+// symbol_registry_free() empties the registry. It must not run while other
+// threads use it.
+void symbol_registry_free(void);
+
+// The one copy of name that every thread gets back for it, so interned names
+// can be compared by address
+const char *intern_name(const char *name);
+
+// Registers the signature of function, a symbol made by
+// add_function_symbol(), unless one of that name is already registered.
+// Returns the registered signature, which is a copy with an interned name and
+// no formals, or NULL if it was registered with another number of arguments.
+const Symbol *register_function_signature(const Symbol *function);
+
+// The signature registered for name, or NULL
+const Symbol *lookup_function_signature(const char *name);
+
+// Number of names interned so far
+int symbol_registry_name_count(void);
+
+#endif
@@ -1,13 +1,208 @@
 #include "symbol_table.h"
+#include "ast.h"
 #include <assert.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
-Symbol *lookup_symbol_in_table(const char *name, const char *type) {
+// Bytes allocated so far for symbols, their names, and scopes
+static size_t bytes_allocated = 0;
+
+size_t symbol_table_bytes(void) { return bytes_allocated; }
+
+static ASTArena *symbol_arena = NULL;
+
+ASTArena *symbol_use_arena(ASTArena *arena) {
+  ASTArena *previous = symbol_arena;
+  symbol_arena = arena;
+  return previous;
+}
+
+// From arena, zeroed, or from malloc when arena is NULL
+static void *symbol_alloc(ASTArena *arena, size_t size) {
+  bytes_allocated += size;
+  if (arena != NULL) {
+    return ast_arena_alloc(arena, size);
+  }
+
+  void *memory = malloc(size);
+  if (!memory) {
+    fprintf(stderr, "ERROR: memory allocation failure\n");
+    exit(1);
+  }
+  return memory;
+}
+
+static char *symbol_strdup(ASTArena *arena, const char *text) {
+  size_t size = strlen(text) + 1;
+  char *copy = symbol_alloc(arena, size);
+  memcpy(copy, text, size);
+  return copy;
+}
+
+// FNV-1a
+unsigned int symbol_name_hash(const char *name) {
+  unsigned int hash = 2166136261u;
+  for (; *name != '\0'; name++) {
+    hash ^= (unsigned char)*name;
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+void *checked_realloc(void *ptr, size_t size) {
+  void *new_ptr = realloc(ptr, size);
+  if (!new_ptr) {
+    fprintf(stderr, "ERROR: Memory allocation failed\n");
+    exit(1);
+  }
+  return new_ptr;
+}
+
+static size_t symbol_address_hash(const Symbol *symbol) {
+  return (size_t)(((uintptr_t)symbol >> 4) * 2654435761u);
+}
+
+// The slot that holds symbol, or the empty one where it would go
+static SymbolIndexSlot *symbol_index_slot(const SymbolIndex *map,
+                                          const Symbol *symbol) {
+  size_t mask = (size_t)map->size - 1;
+  size_t slot = symbol_address_hash(symbol) & mask;
+  while (map->slots[slot].symbol != NULL && map->slots[slot].symbol != symbol) {
+    slot = (slot + 1) & mask;
+  }
+  return &map->slots[slot];
+}
+
+void symbol_index_put(SymbolIndex *map, const Symbol *symbol, int index) {
+  // Kept at most 70% full
+  if ((map->count + 1) * 10 > map->size * 7) {
+    SymbolIndexSlot *old_slots = map->slots;
+    int old_size = map->size;
+    map->size = (old_size == 0) ? 64 : old_size * 2;
+    map->slots = calloc(map->size, sizeof(SymbolIndexSlot));
+    if (!map->slots) {
+      fprintf(stderr, "ERROR: Memory allocation failed\n");
+      exit(1);
+    }
+    for (int i = 0; i < old_size; i++) {
+      if (old_slots[i].symbol != NULL) {
+        *symbol_index_slot(map, old_slots[i].symbol) = old_slots[i];
+      }
+    }
+    free(old_slots);
+  }
+
+  SymbolIndexSlot *slot = symbol_index_slot(map, symbol);
+  if (slot->symbol == NULL) {
+    slot->symbol = symbol;
+    map->count++;
+  }
+  slot->index = index;
+}
+
+int symbol_index_get(const SymbolIndex *map, const Symbol *symbol) {
+  if (map->size == 0) {
+    return -1;
+  }
+  const SymbolIndexSlot *slot = symbol_index_slot(map, symbol);
+  return (slot->symbol != NULL) ? slot->index : -1;
+}
+
+void symbol_index_free(SymbolIndex *map) {
+  free(map->slots);
+  map->slots = NULL;
+  map->size = 0;
+  map->count = 0;
+}
+
+static ScopeEntry *find_entry(const Scope *scope, const char *name,
+                              unsigned int hash) {
+  if (scope->table_size == 0) {
+    return NULL;
+  }
+
+  size_t mask = (size_t)scope->table_size - 1;
+  size_t slot = hash & mask;
+  while (scope->table[slot].symbol != NULL) {
+    ScopeEntry *entry = &scope->table[slot];
+    if (entry->hash == hash && strcmp(entry->symbol->name, name) == 0) {
+      return entry;
+    }
+    slot = (slot + 1) & mask;
+  }
+  return NULL;
+}
+
+static void insert_entry(ScopeEntry *table, int table_size, unsigned int hash,
+                         Symbol *symbol) {
+  size_t mask = (size_t)table_size - 1;
+  size_t slot = hash & mask;
+  while (table[slot].symbol != NULL) {
+    slot = (slot + 1) & mask;
+  }
+  table[slot].hash = hash;
+  table[slot].symbol = symbol;
+}
+
+static void grow_table(Scope *scope) {
+  int new_size = (scope->table_size == 0) ? 16 : scope->table_size * 2;
+  ScopeEntry *new_table =
+      symbol_alloc(scope->arena, new_size * sizeof(ScopeEntry));
+  memset(new_table, 0, new_size * sizeof(ScopeEntry));
+
+  for (int i = 0; i < scope->table_size; i++) {
+    if (scope->table[i].symbol != NULL) {
+      insert_entry(new_table, new_size, scope->table[i].hash,
+                   scope->table[i].symbol);
+    }
+  }
+  if (scope->arena == NULL) {
+    free(scope->table);
+  }
+  scope->table = new_table;
+  scope->table_size = new_size;
+}
+
+// Enters symbol in scope's table, in place of any symbol of the same name
+static void scope_index(Scope *scope, Symbol *symbol) {
+  unsigned int hash = symbol_name_hash(symbol->name);
+  ScopeEntry *entry = find_entry(scope, symbol->name, hash);
+  if (entry != NULL) {
+    entry->symbol = symbol;
+  } else {
+    // Kept at most 75% full
+    if ((scope->symbol_count + 1) * 4 > scope->table_size * 3) {
+      grow_table(scope);
+    }
+    insert_entry(scope->table, scope->table_size, hash, symbol);
+    scope->symbol_count++;
+  }
+}
+
+// Links symbol into scope. A symbol with the name of one already there
+// shadows it, as the newer one is found first in the list.
+static void scope_insert(Scope *scope, Symbol *symbol) {
+  scope_index(scope, symbol);
+  symbol->next = scope->symbols;
+  scope->symbols = symbol;
+}
+
+static Symbol *lookup_hashed(const char *name, unsigned int hash,
+                             SymbolKind kind, const Scope *scope) {
+  const ScopeEntry *entry = find_entry(scope, name, hash);
+  if (entry == NULL || entry->symbol->kind != kind) {
+    return NULL;
+  }
+  return entry->symbol;
+}
+
+Symbol *lookup_symbol_in_table(const char *name, SymbolKind kind) {
+  unsigned int hash = symbol_name_hash(name);
   const Scope *currentScopePtr = currentScope;
   while (currentScopePtr != NULL) {
-    Symbol *symbol = lookup_symbol_in_scope(name, type, currentScopePtr);
+    Symbol *symbol = lookup_hashed(name, hash, kind, currentScopePtr);
     if (symbol != NULL) {
       return symbol;
     }
@@ -16,60 +211,37 @@ Symbol *lookup_symbol_in_table(const char *name, const char *type) {
   return NULL;
 }
 
-Symbol *lookup_symbol_in_scope(const char *name, const char *type,
-                               const Scope *scope) {
-  Symbol *symbol = scope->symbols;
-  while (symbol != NULL) {
-    // Check matching name
-    if (strcmp(symbol->name, name) != 0) {
-      symbol = symbol->next;
-      continue;
-    }
-    // Check matching type
-    if (strcmp(symbol->type, type) != 0) {
-      symbol = symbol->next;
-      continue;
+Symbol *lookup_variable_in_table(const char *name) {
+  unsigned int hash = symbol_name_hash(name);
+  for (const Scope *scope = currentScope; scope != NULL;
+       scope = scope->parent) {
+    const ScopeEntry *entry = find_entry(scope, name, hash);
+    if (entry != NULL && entry->symbol->kind != SYMBOL_FUNCTION) {
+      return entry->symbol;
     }
-
-    // Match found
-    return symbol;
   }
   return NULL;
 }
 
-bool check_duplicate_symbol_in_scope(const char *name, const char *type,
-                                     const Scope *scope) {
+Symbol *lookup_symbol_in_scope(const char *name, SymbolKind kind,
+                               const Scope *scope) {
+  return lookup_hashed(name, symbol_name_hash(name), kind, scope);
+}
+
+// A name may be declared once per scope, whatever it names
+bool check_duplicate_symbol_in_scope(const char *name, const Scope *scope) {
   assert(scope != NULL);
   assert(name != NULL);
-  assert(type != NULL);
 
-  Symbol *symbol = scope->symbols;
-  while (symbol != NULL) {
-    // Check matching name
-    if (strcmp(symbol->name, name) != 0) {
-      symbol = symbol->next;
-      continue;
-    }
-
-    // Duplicate found
-    return true;
-  }
-  return false;
+  return find_entry(scope, name, symbol_name_hash(name)) != NULL;
 }
 
-Symbol *create_symbol(const char *name) {
-  Symbol *symbol = malloc(sizeof(Symbol));
-  if (!symbol) {
-    fprintf(stderr, "ERROR: memory allocation failure\n");
-    return false;
-  }
-  symbol->name = strdup(name);
-  if (!symbol->name) {
-    free(symbol);
-    fprintf(stderr, "ERROR: memory allocation failure for symbolbol name\n");
-    return false;
-  }
-  symbol->type = NULL;
+static Symbol *new_symbol(const char *name, ASTArena *arena) {
+  Symbol *symbol = symbol_alloc(arena, sizeof(Symbol));
+  symbol->name = symbol_strdup(arena, name);
+  symbol->kind = SYMBOL_VARIABLE;
+  symbol->flags = 0;
+  symbol->value = 0;
   symbol->number_of_arguments = 0;
   symbol->arguments = NULL;
   symbol->next = NULL;
@@ -82,73 +254,65 @@ Symbol *create_symbol(const char *name) {
   return symbol;
 }
 
+Symbol *create_symbol(const char *name) {
+  return new_symbol(name, symbol_arena);
+}
+
+Symbol *copy_symbol(const Symbol *symbol, ASTArena *arena) {
+  Symbol *copy = symbol_alloc(arena, sizeof(Symbol));
+  *copy = *symbol;
+  copy->name = symbol_strdup(arena, symbol->name);
+  copy->next = NULL;
+  copy->scope = NULL;
+  return copy;
+}
+
 // Add a new symbol to the given scope. Caller should have already checked
 // for duplicates.
-bool add_symbol(const char *name, const char *type) {
-  Symbol *symbol = create_symbol(name);
-
-  symbol->type = strdup(type);
-  if (!symbol->type) {
-    free(symbol->name);
-    free(symbol);
-    fprintf(stderr, "ERROR: memory allocation failure for symbol type\n");
-    return false;
-  }
+bool add_symbol(const char *name, SymbolKind kind) {
+  Symbol *symbol = new_symbol(name, currentScope->arena);
+  symbol->kind = kind;
 
   // Mips logic
   symbol->scope = currentScope;
 
-  if (currentScope != globalScope && strcmp(type, "variable") == 0) {
+  if (currentScope != globalScope && kind == SYMBOL_VARIABLE) {
     symbol->offset = currentScope->current_offset;
     currentScope->current_offset -= 4;
+    symbol->flags = SYMBOL_LOCAL;
   } else {
     symbol->offset = 0;
+    symbol->flags = (currentScope == globalScope) ? SYMBOL_GLOBAL : 0;
   }
   // End mips
 
-  symbol->next = currentScope->symbols;
-  currentScope->symbols = symbol;
+  scope_insert(currentScope, symbol);
   return true;
 }
 
 bool add_function_symbol(const char *name) {
-  return add_symbol(name, "function");
+  return add_symbol(name, SYMBOL_FUNCTION);
 }
 
 bool add_variable_symbol(const char *name) {
-  return add_symbol(name, "variable");
+  return add_symbol(name, SYMBOL_VARIABLE);
 }
 
-bool add_function_formal(const char *name) {
-  if (currentScope->parent == NULL) {
-    fprintf(stderr, "the current scope has no parents");
-    exit(1);
-  }
-
-  Scope *parentScope = currentScope->parent;
-  if (!parentScope) {
-    fprintf(stderr, "mising parent scope");
-    exit(1);
-  }
-
-  Symbol *function = parentScope->symbols;
-  if (!function) {
-    fprintf(stderr, "the global scope had no symbols");
+// The formal's next pointer links function's arguments, so it goes in the
+// scope's table but not in its symbol list
+Symbol *add_function_formal(Symbol *function, const char *name) {
+  if (currentScope == globalScope) {
+    fprintf(stderr, "ERROR: formal %s outside a function\n", name);
     exit(1);
   }
 
-  Symbol *argument_ptr = create_symbol(name);
+  Symbol *argument_ptr = new_symbol(name, NULL);
 
   int parameter_index = function->number_of_arguments;
   argument_ptr->offset = 8 + (parameter_index * 4);
-  argument_ptr->type = strdup("parameter");
+  argument_ptr->kind = SYMBOL_PARAMETER;
+  argument_ptr->flags = SYMBOL_PARAM;
   argument_ptr->scope = currentScope;
-  if (!argument_ptr->type) {
-    fprintf(stderr, "ERROR: memory allocation failure for formal type\n");
-    free(argument_ptr->name);
-    free(argument_ptr);
-    return false;
-  }
 
   if (function->arguments == NULL) {
     function->arguments = argument_ptr;
@@ -161,19 +325,21 @@ bool add_function_formal(const char *name) {
   }
   function->number_of_arguments++;
 
-  return true;
+  scope_index(currentScope, argument_ptr);
+  return argument_ptr;
 }
 
 // Push a new scope onto the scope stack.
 void pushScope(void) {
-  Scope *newScope = malloc(sizeof(Scope));
-  if (!newScope) {
-    fprintf(stderr, "ERROR: memory allocation failure in pushScope\n");
-    exit(1);
-  }
+  Scope *newScope = symbol_alloc(symbol_arena, sizeof(Scope));
   newScope->symbols = NULL;
   newScope->parent = currentScope;
 
+  newScope->table = NULL;
+  newScope->table_size = 0;
+  newScope->symbol_count = 0;
+  newScope->arena = symbol_arena;
+
   // Mips logic
   newScope->current_offset = -8;
 
@@ -181,61 +347,50 @@ void pushScope(void) {
   currentScope = newScope;
 }
 
-// Pop the current scope off the scope stack, freeing its symbols.
+// Pop the current scope off the scope stack. The AST and quads still refer to
+// its symbols, so they stay until the arena they came from is destroyed.
 void popScope(void) {
   if (currentScope == NULL) {
     fprintf(stderr, "ERROR: no scope to pop\n");
     return;
   }
 
-  // Scope *temp = currentScope;
   currentScope = currentScope->parent;
-
-  // Decided to just leak symbols + names for the ast and quad
-
-  // Symbol *symbol = temp->symbols;
-  // Symbol *next_symbol = NULL;
-
-  // while (symbol != NULL) {
-  //   next_symbol = symbol->next;
-  //   free(symbol->name);
-  //   free(symbol);
-  //   symbol = next_symbol;
-  // }
 }
 
 void initSymbolTable(void) {
-  globalScope = malloc(sizeof(Scope));
-  if (!globalScope) {
-    fprintf(stderr, "ERROR: memory allocation failure in initSymbolTable\n");
-    exit(1);
-  }
+  globalScope = symbol_alloc(NULL, sizeof(Scope));
   globalScope->symbols = NULL;
   globalScope->parent = NULL;
+  globalScope->current_offset = 0;
+  globalScope->table = NULL;
+  globalScope->table_size = 0;
+  globalScope->symbol_count = 0;
+  globalScope->arena = NULL;
   currentScope = globalScope;
-  Symbol *println_symbol = create_symbol("println");
+  Symbol *println_symbol = new_symbol("println", NULL);
   println_symbol->number_of_arguments = 1;
-  println_symbol->type = strdup("function");
-  globalScope->symbols = println_symbol;
+  println_symbol->kind = SYMBOL_FUNCTION;
+  println_symbol->flags = SYMBOL_GLOBAL;
+  scope_insert(globalScope, println_symbol);
 }
 
+// Walks the list iteratively, since a scope may hold very many symbols
 void free_symbol(Symbol *symbol) {
+  while (symbol != NULL) {
+    Symbol *next = symbol->next;
 
-  if (symbol == NULL) {
-    return;
-  }
+    free(symbol->name);
+    free_symbol(symbol->arguments);
 
-  free(symbol->name);
-  free(symbol->type);
-  free_symbol(symbol->arguments);
-  free_symbol(symbol->next);
+    symbol->name = NULL;
+    symbol->value = 0;
+    symbol->number_of_arguments = 0;
+    symbol->arguments = NULL;
+    symbol->next = NULL;
 
-  symbol->name = NULL;
-  symbol->type = NULL;
-  symbol->value = 0;
-  symbol->number_of_arguments = 0;
-  symbol->arguments = NULL;
-  symbol->next = NULL;
+    symbol = next;
+  }
 }
 
 void free_scope(Scope *scope) {
@@ -243,11 +398,18 @@ void free_scope(Scope *scope) {
     return;
   }
 
-  free_symbol(scope->symbols);
+  // A scope in an arena goes with the arena
+  if (scope->arena == NULL) {
+    free_symbol(scope->symbols);
+    free(scope->table);
+  }
   free_scope(scope->parent);
 
   scope->symbols = NULL;
   scope->parent = NULL;
+  scope->table = NULL;
+  scope->table_size = 0;
+  scope->symbol_count = 0;
 }
 
 void free_symbol_table(void) {
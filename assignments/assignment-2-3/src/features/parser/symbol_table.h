@@ -2,11 +2,32 @@
 #define SYMBOL_TABLE_H
 
 #include <stdbool.h>
+#include <stddef.h>
+
+// See ast.h
+typedef struct ASTArena ASTArena;
+
+// What a symbol names. Lookups match on it.
+typedef enum SymbolKind {
+    SYMBOL_FUNCTION,
+    SYMBOL_VARIABLE,
+    SYMBOL_PARAMETER,
+    SYMBOL_KIND_COUNT
+} SymbolKind;
+
+// Where a symbol's value is kept, one bit of Symbol::flags each
+#define SYMBOL_GLOBAL 0x1 // functions and global variables
+#define SYMBOL_LOCAL 0x2  // in the frame below $fp
+#define SYMBOL_PARAM 0x4  // in the frame above $fp
+#define SYMBOL_EXTERN 0x8 // global imported from another unit's .sym file
 
 typedef struct Symbol {
     char *name;
-    char *type;
+    SymbolKind kind;
+    unsigned int flags;
     int value;
+    // A function's arity. Only its formals add to it, so it is fixed once
+    // the function's header is parsed; calls are checked against it.
     int number_of_arguments;
     struct Symbol *arguments;
     struct Symbol *next;
@@ -16,29 +37,79 @@ typedef struct Symbol {
     int local_var_bytes;
 } Symbol;
 
+// Slot of a scope's hash table, empty when symbol is NULL
+typedef struct ScopeEntry {
+    unsigned int hash;
+    Symbol *symbol;
+} ScopeEntry;
+
 typedef struct Scope {
     Symbol *symbols;
     struct Scope *parent;
     // Mips stuff
     int current_offset;
+    // Open addressing from name to the newest symbol of that name, for
+    // lookups. symbols keeps the declaration order for code generation.
+    ScopeEntry *table;
+    int table_size;
+    int symbol_count;
+    // Holds the scope, its table and its symbols, or NULL if they are malloc'd
+    ASTArena *arena;
 } Scope;
 
+// Maps symbols, by address, to indices into an array kept by the map's
+// owner. A zeroed SymbolIndex is an empty map.
+typedef struct SymbolIndexSlot {
+    const Symbol *symbol; // NULL when the slot is empty
+    int index;
+} SymbolIndexSlot;
+
+typedef struct SymbolIndex {
+    SymbolIndexSlot *slots;
+    int size;
+    int count;
+} SymbolIndex;
+
 extern Scope *globalScope;
 extern Scope *currentScope;
 
-Symbol *lookup_symbol_in_scope(const char *name, const char *type, const Scope *scope);
-Symbol *lookup_symbol_in_table(const char *name, const char *type);
-bool check_duplicate_symbol_in_scope(const char *name, const char *type, const
-                                      Scope *scope);
+// FNV-1a of name, which the scopes' tables are keyed on
+unsigned int symbol_name_hash(const char *name);
+// Maps symbol to index, replacing what it was mapped to before
+void symbol_index_put(SymbolIndex *map, const Symbol *symbol, int index);
+// The index symbol is mapped to, or -1
+int symbol_index_get(const SymbolIndex *map, const Symbol *symbol);
+// Empties map and releases its slots
+void symbol_index_free(SymbolIndex *map);
+// realloc() that reports running out of memory and exits
+void *checked_realloc(void *ptr, size_t size);
+Symbol *lookup_symbol_in_scope(const char *name, SymbolKind kind,
+                               const Scope *scope);
+Symbol *lookup_symbol_in_table(const char *name, SymbolKind kind);
+// Innermost variable or parameter called name, skipping functions
+Symbol *lookup_variable_in_table(const char *name);
+bool check_duplicate_symbol_in_scope(const char *name, const Scope *scope);
 Symbol *create_symbol(const char *name);
-bool add_symbol(const char *name, const char *type);
+// Copy of symbol, with its name, in arena. The copy is in no scope list.
+Symbol *copy_symbol(const Symbol *symbol, ASTArena *arena);
+bool add_symbol(const char *name, SymbolKind kind);
 bool add_function_symbol(const char *name);
 bool add_variable_symbol(const char *name);
-bool add_function_formal(const char *name);
+// Appends a formal called name to function's arguments and enters it in the
+// current scope, which must be the function body's
+Symbol *add_function_formal(Symbol *function, const char *name);
+// While arena is set, the scopes pushed, the symbols added to them and the
+// symbols made by create_symbol() are allocated from it, so a function's
+// symbols can be released in one go once its code has been emitted. Global
+// symbols and formals, which later functions refer to, are always malloc'd.
+// Returns the previous arena.
+ASTArena *symbol_use_arena(ASTArena *arena);
 void pushScope(void);
 void popScope(void);
 void initSymbolTable(void);
 void free_symbol_table(void);
+// Bytes allocated for symbols and scopes since the program started
+size_t symbol_table_bytes(void);
 
 #endif
 
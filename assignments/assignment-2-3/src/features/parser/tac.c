@@ -1,12 +1,14 @@
 #include "tac.h"
 #include "ast.h"
+#include "fold.h"
 #include "symbol_table.h"
 #include <assert.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
-extern int DEBUG_ON;
+extern bool DEBUG_ON;
+extern int fold_flag;
 int TAC_DEBUG_ON = true;
 
 void debug_tac(char *message) {
@@ -18,13 +20,57 @@ void debug_tac(char *message) {
   fflush(stdout);
 }
 
-Operand *new_operand(OperandType op_type, void *value) {
-  Operand *operand = malloc(sizeof(Operand));
+// When set, quads, operands and spill slots are taken from this arena so a
+// caller can drop a whole function's TAC at once. One per thread, since the
+// --pipeline backend lowers functions on its own thread.
+static _Thread_local ASTArena *tac_arena = NULL;
+
+ASTArena *tac_use_arena(ASTArena *arena) {
+  ASTArena *previous = tac_arena;
+  tac_arena = arena;
+  return previous;
+}
 
-  if (!operand) {
+static void *tac_alloc(size_t size) {
+  if (tac_arena != NULL) {
+    return ast_arena_alloc(tac_arena, size);
+  }
+
+  void *memory = malloc(size);
+  if (!memory) {
     fprintf(stderr, "ERROR: Memory allocation failed\n");
     exit(1);
   }
+  return memory;
+}
+
+static char *tac_strdup(const char *text) {
+  size_t size = strlen(text) + 1;
+  char *copy = tac_alloc(size);
+  memcpy(copy, text, size);
+  return copy;
+}
+
+// Symbols made by the translation itself
+static Symbol *new_tac_symbol(const char *name, SymbolKind kind,
+                              unsigned int flags) {
+  Symbol *symbol = tac_alloc(sizeof(Symbol));
+
+  symbol->name = tac_strdup(name);
+  symbol->kind = kind;
+  symbol->flags = flags;
+  symbol->number_of_arguments = 0;
+  symbol->arguments = NULL;
+  symbol->next = NULL;
+  symbol->offset = 0;
+  symbol->scope = NULL;
+  symbol->local_var_bytes = 0;
+
+  return symbol;
+}
+
+Operand *new_operand(OperandType op_type, void *value) {
+  Operand *operand = tac_alloc(sizeof(Operand));
 
   operand->operand_type = op_type;
 
@@ -36,6 +82,10 @@ Operand *new_operand(OperandType op_type, void *value) {
   case SYM_TABLE_PTR:
     operand->val.symbol_ptr = (Symbol *)value;
     break;
+
+  case TEMP_REG:
+    operand->val.temp = *(int *)value;
+    break;
   }
 
   return operand;
@@ -46,29 +96,14 @@ int temp_counter = 0;
 void reset_temp_counter() { temp_counter = 0; }
 
 // Based on lecture slide 05
-Symbol *new_temp(char *type) {
-  char *temp_name = malloc(20);
-  sprintf(temp_name, "t%d", temp_counter++);
-
-  Symbol *new_temp = create_symbol(temp_name);
-
-  new_temp->type = strdup(type);
-
-  if (!new_temp->type) {
-    free(new_temp->name);
-    free(new_temp);
-    fprintf(stderr, "ERROR: memory allocation failure for symbol type\n");
-    exit(1);
-  }
-
-  new_temp->next = currentScope->symbols;
-  currentScope->symbols = new_temp;
-
-  return new_temp;
+// A temporary is only a number, so it takes no symbol, name or scope entry
+Operand *new_temp(void) {
+  int temp = temp_counter++;
+  return new_operand(TEMP_REG, &temp);
 }
 
 Quad *new_instr(OpType opType, Operand *src1, Operand *src2, Operand *dest) {
-  Quad *new_instr = malloc(sizeof(Quad));
+  Quad *new_instr = tac_alloc(sizeof(Quad));
   new_instr->op = opType;
   new_instr->src1 = src1;
   new_instr->src2 = src2;
@@ -79,12 +114,40 @@ Quad *new_instr(OpType opType, Operand *src1, Operand *src2, Operand *dest) {
 }
 
 static int label_num = 0;
+
+void reset_label_counter() { label_num = 0; }
+
 Quad *new_label() {
   Operand *src1 = new_operand(INTEGER_CONSTANT, &label_num);
   label_num++;
   return new_instr(TAC_LABEL, src1, NULL, NULL);
 }
 
+// The function whose body is being translated, and the label in front of its
+// epilogue that every return jumps to
+static Symbol *current_function = NULL;
+static Quad *current_exit_label = NULL;
+
+int new_frame_slot(Symbol *function) {
+  // Locals start at -8($fp), so an empty frame grows straight to 8 bytes
+  int frame_bytes = function->local_var_bytes;
+  frame_bytes = (frame_bytes == 0) ? 8 : frame_bytes + 4;
+  function->local_var_bytes = frame_bytes;
+  return -frame_bytes;
+}
+
+// Reserves a word in the current function's frame. Used for values that must
+// survive a call, since temporaries live in $t registers that the callee may
+// overwrite.
+Symbol *new_spill_slot() {
+  assert(current_function != NULL);
+
+  Symbol *slot = new_tac_symbol("spill", SYMBOL_VARIABLE, SYMBOL_LOCAL);
+  slot->offset = new_frame_slot(current_function);
+
+  return slot;
+}
+
 Quad *reverse_tac_list(Quad *head) {
   Quad *prev = NULL;
   Quad *current = head;
@@ -99,18 +162,80 @@ Quad *reverse_tac_list(Quad *head) {
   return prev;
 }
 
-void bool_helper(ASTnode *node, Quad *trueDest, Quad *falseDest, OpType op_type,
-                 Quad **code_list) {
-  Symbol *left = make_TAC(node->child0, code_list);
-  Symbol *right = make_TAC(node->child1, code_list);
+// Returns the conditional jump that tests the negation of op_type
+OpType invert_branch(OpType op_type) {
+  switch (op_type) {
+  case TAC_IF_EQ:
+    return TAC_IF_NE;
+  case TAC_IF_NE:
+    return TAC_IF_EQ;
+  case TAC_IF_LT:
+    return TAC_IF_GE;
+  case TAC_IF_GE:
+    return TAC_IF_LT;
+  case TAC_IF_LE:
+    return TAC_IF_GT;
+  case TAC_IF_GT:
+    return TAC_IF_LE;
+  default:
+    fprintf(stderr, "ERROR: cannot invert TAC op %d\n", op_type);
+    exit(1);
+  }
+}
+
+// fallDest is the label emitted right after this condition (or NULL). A jump
+// to it is left out, so each comparison costs a single conditional branch
+// whenever one of its targets is the next instruction.
+void bool_helper(void *node, Quad *trueDest, Quad *falseDest,
+                 Quad *fallDest, OpType op_type, Quad **code_list) {
+  Operand *left = NULL;
+  Operand *right = NULL;
+  void *lhs = expr_operand_1(node);
+  void *rhs = expr_operand_2(node);
+
+  if (ast_right_operand_first(node)) {
+    // Making the call first keeps the left value out of the registers the
+    // callee is free to use
+    right = make_TAC(rhs, code_list);
+    left = make_TAC(lhs, code_list);
+  } else {
+    left = make_TAC(lhs, code_list);
+
+    if (ast_contains_call(rhs) && ast_node_type(lhs) != IDENTIFIER) {
+      // Both sides call, so the left value has to wait in the frame
+      Operand *slot = new_operand(SYM_TABLE_PTR, new_spill_slot());
+      Quad *spill_instr = new_instr(TAC_ASSIGN, left, NULL, slot);
+
+      spill_instr->next = *code_list;
+      *code_list = spill_instr;
+      left = slot;
+    }
+
+    right = make_TAC(rhs, code_list);
+  }
+
+  Operand *src1 = left;
+  Operand *src2 = right;
+  Quad *instruction = NULL;
+
+  if (fallDest == trueDest) {
+    // Fall into the true block, only jump away when the test fails
+    instruction =
+        new_instr(invert_branch(op_type), src1, src2, falseDest->src1);
+    instruction->next = *code_list;
+    *code_list = instruction;
+    return;
+  }
 
-  Operand *src1 = new_operand(SYM_TABLE_PTR, left);
-  Operand *src2 = new_operand(SYM_TABLE_PTR, right);
-  Quad *instruction = new_instr(op_type, src1, src2, trueDest->src1);
+  instruction = new_instr(op_type, src1, src2, trueDest->src1);
 
   instruction->next = *code_list;
   *code_list = instruction;
 
+  if (fallDest == falseDest) {
+    return;
+  }
+
   op_type = TAC_GOTO;
   instruction = NULL;
   instruction = new_instr(op_type, NULL, NULL, falseDest->src1);
@@ -119,109 +244,185 @@ void bool_helper(ASTnode *node, Quad *trueDest, Quad *falseDest, OpType op_type,
   *code_list = instruction;
 }
 
-void make_bool(ASTnode *node, Quad *trueDest, Quad *falseDest,
+// Generates jump code for a boolean expression: control reaches trueDest if
+// the expression holds and falseDest otherwise. && and || are short-circuited
+// by threading the labels through the operands, so no 0/1 value is ever
+// computed.
+void make_bool(void *node, Quad *trueDest, Quad *falseDest, Quad *fallDest,
                Quad **code_list) {
 
   OpType op_type = TAC_IF_EQ;
 
-  switch (node->node_type) {
-  // case AND: {
-  //   Quad *L_eval_B = new_label();
-  //   make_bool(node->child0, L_eval_B, falseDest, code_list);
-  //   L_eval_B->next = *code_list;
-  //   *code_list = L_eval_B;
-  //   make_bool(node->child1, trueDest, falseDest, code_list);
-  //   break;
-  // }
-  // case OR: {
-  //   Quad *L_eval_B = new_label();
-  //   make_bool(node->child0, trueDest, L_eval_B, code_list);
-  //   L_eval_B->next = *code_list;
-  //   *code_list = L_eval_B;
-  //   make_bool(node->child1, trueDest, falseDest, code_list);
-  //   break;
-  // }
+  // With --fold, a condition that always has the same outcome is a plain
+  // jump, or nothing at all when that outcome is where control falls anyway
+  int known_value = fold_flag ? fold_condition_value(node) : -1;
+  if (known_value >= 0) {
+    Quad *dest = known_value ? trueDest : falseDest;
+    if (dest != fallDest) {
+      Quad *jump = new_instr(TAC_GOTO, NULL, NULL, dest->src1);
+      jump->next = *code_list;
+      *code_list = jump;
+    }
+    return;
+  }
+
+  switch (ast_node_type(node)) {
+  case AND: {
+    // Only evaluate B if A was true
+    Quad *L_eval_B = new_label();
+    make_bool(expr_operand_1(node), L_eval_B, falseDest, L_eval_B, code_list);
+    L_eval_B->next = *code_list;
+    *code_list = L_eval_B;
+    make_bool(expr_operand_2(node), trueDest, falseDest, fallDest, code_list);
+    break;
+  }
+  case OR: {
+    // Only evaluate B if A was false
+    Quad *L_eval_B = new_label();
+    make_bool(expr_operand_1(node), trueDest, L_eval_B, L_eval_B, code_list);
+    L_eval_B->next = *code_list;
+    *code_list = L_eval_B;
+    make_bool(expr_operand_2(node), trueDest, falseDest, fallDest, code_list);
+    break;
+  }
+  case NOT:
+    // Swap the targets instead of computing a value
+    make_bool(expr_operand_1(node), falseDest, trueDest, fallDest, code_list);
+    break;
   case EQ: {
     op_type = TAC_IF_EQ;
-    bool_helper(node, trueDest, falseDest, op_type, code_list);
+    bool_helper(node, trueDest, falseDest, fallDest, op_type, code_list);
   } break;
   case GE: {
     op_type = TAC_IF_GE;
-    bool_helper(node, trueDest, falseDest, op_type, code_list);
+    bool_helper(node, trueDest, falseDest, fallDest, op_type, code_list);
   } break;
   case GT: {
     op_type = TAC_IF_GT;
-    bool_helper(node, trueDest, falseDest, op_type, code_list);
+    bool_helper(node, trueDest, falseDest, fallDest, op_type, code_list);
   } break;
   case LE: {
     op_type = TAC_IF_LE;
-    bool_helper(node, trueDest, falseDest, op_type, code_list);
+    bool_helper(node, trueDest, falseDest, fallDest, op_type, code_list);
   } break;
   case LT: {
     op_type = TAC_IF_LT;
-    bool_helper(node, trueDest, falseDest, op_type, code_list);
+    bool_helper(node, trueDest, falseDest, fallDest, op_type, code_list);
   } break;
   case NE: {
     op_type = TAC_IF_NE;
-    bool_helper(node, trueDest, falseDest, op_type, code_list);
+    bool_helper(node, trueDest, falseDest, fallDest, op_type, code_list);
   } break;
   default:
     break;
   }
 }
 
-Symbol *make_TAC(ASTnode *node, Quad **code_list) {
-  Symbol *temp = NULL;
-  Symbol *left = NULL;
-  Symbol *right = NULL;
+int count_call_args(void *expr_list) {
+  return (expr_list != NULL) ? expr_list_length(expr_list) : 0;
+}
+
+// Generates a call. When the caller uses the result, it is moved out of $v0
+// into a fresh temporary by TAC_RETRIEVE, so it never goes through memory.
+Operand *make_call(void *node, bool returns_value, Quad **code_list) {
+  debug_tac("FUNC_CALL");
+
+  Symbol *func_symbol = ast_node_symbol(node);
+  Operand *return_val_temp = NULL;
+  Quad *call_instr = NULL;
+  Quad *retrieve_instr = NULL;
+
+  make_TAC(func_call_args(node), code_list);
+
+  if (returns_value) {
+    // E.place = newtemp(f.returnType);
+    return_val_temp = new_temp();
+  }
+
+  // Count the arguments from the call itself, since those of println are not
+  // checked against its arity
+  int n_args = count_call_args(func_call_args(node));
+
+  Operand *src1 = new_operand(SYM_TABLE_PTR, func_symbol);
+  Operand *src2 = new_operand(INTEGER_CONSTANT, &n_args);
+  call_instr = new_instr(TAC_CALL, src1, src2, NULL);
+
+  call_instr->next = *code_list;
+  *code_list = call_instr;
+
+  if (return_val_temp != NULL) {
+    retrieve_instr = new_instr(TAC_RETRIEVE, NULL, NULL, return_val_temp);
+
+    // Prepend RETRIEVE instruction (goes after CALL)
+    retrieve_instr->next = *code_list;
+    *code_list = retrieve_instr;
+  }
+
+  return return_val_temp;
+}
+
+// A call used as a statement throws its result away, so skip the RETRIEVE
+void make_stmt_TAC(void *node, Quad **code_list) {
+  if (node != NULL && ast_node_type(node) == FUNC_CALL) {
+    make_call(node, false, code_list);
+    return;
+  }
+  make_TAC(node, code_list);
+}
+
+Operand *make_TAC(void *node, Quad **code_list) {
+  Operand *temp = NULL;
+  Operand *left = NULL;
+  Operand *right = NULL;
 
   OpType op_type;
-  Operand *dest = NULL;
   Operand *src1 = NULL;
-  Operand *src2 = NULL;
 
   Quad *instruction = NULL;
 
   if (!node)
     return NULL;
 
-  switch (node->node_type) {
-  case INTCONST:
+  NodeType node_type = ast_node_type(node);
+
+  switch (node_type) {
+  case INTCONST: {
     debug_tac("INTCONST");
-    temp = new_temp("variable");
+    int value = expr_intconst_val(node);
+    temp = new_temp();
 
-    dest = new_operand(SYM_TABLE_PTR, temp);
-    src1 = new_operand(INTEGER_CONSTANT, &(node->num));
-    instruction = new_instr(TAC_ASSIGN, src1, NULL, dest);
+    src1 = new_operand(INTEGER_CONSTANT, &value);
+    instruction = new_instr(TAC_ASSIGN, src1, NULL, temp);
 
     instruction->next = *code_list;
     *code_list = instruction;
     return temp;
+  }
 
   case IDENTIFIER:
     debug_tac("IDENTIFIER");
-    return node->symbol;
+    return new_operand(SYM_TABLE_PTR, ast_node_symbol(node));
 
   case ADD:
   case SUB:
   case MUL:
   case DIV:
-    left = make_TAC(node->child0, code_list);
-    right = make_TAC(node->child1, code_list);
-
-    temp = new_temp("variable");
-    instruction = malloc(sizeof(Quad));
+    if (ast_right_operand_first(node)) {
+      right = make_TAC(expr_operand_2(node), code_list);
+      left = make_TAC(expr_operand_1(node), code_list);
+    } else {
+      left = make_TAC(expr_operand_1(node), code_list);
+      right = make_TAC(expr_operand_2(node), code_list);
+    }
 
-    op_type = (node->node_type == ADD)   ? TAC_ADD
-              : (node->node_type == SUB) ? TAC_SUB
-              : (node->node_type == MUL) ? TAC_MUL
-                                         : TAC_DIV;
+    temp = new_temp();
 
-    src1 = new_operand(SYM_TABLE_PTR, left);
-    src2 = new_operand(SYM_TABLE_PTR, right);
-    dest = new_operand(SYM_TABLE_PTR, temp);
+    op_type = (node_type == ADD)   ? TAC_ADD
+              : (node_type == SUB) ? TAC_SUB
+              : (node_type == MUL) ? TAC_MUL
+                                   : TAC_DIV;
 
-    instruction = new_instr(op_type, src1, src2, dest);
+    instruction = new_instr(op_type, left, right, temp);
 
     instruction->next = *code_list;
     *code_list = instruction;
@@ -229,43 +430,46 @@ Symbol *make_TAC(ASTnode *node, Quad **code_list) {
     return temp;
 
   case ASSG:
-    left = node->child0->symbol;
-    right = make_TAC(node->child1, code_list);
+    right = make_TAC(stmt_assg_rhs(node), code_list);
 
     op_type = TAC_ASSIGN;
-    src1 = new_operand(SYM_TABLE_PTR, right);
-    dest = new_operand(SYM_TABLE_PTR, left);
+    left = new_operand(SYM_TABLE_PTR, ast_node_symbol(ast_node_child(node, 0)));
 
-    instruction = new_instr(op_type, src1, src2, dest);
+    instruction = new_instr(op_type, right, NULL, left);
 
     instruction->next = *code_list;
     *code_list = instruction;
 
     return NULL;
 
-  case FUNC_DEF:
-    left = node->symbol;
+  case FUNC_DEF: {
+    Symbol *function = ast_node_symbol(node);
 
     // Generate TAC_ENTER for the function
     op_type = TAC_ENTER;
-    src1 = new_operand(SYM_TABLE_PTR, left);
+    src1 = new_operand(SYM_TABLE_PTR, function);
     instruction = new_instr(op_type, src1, NULL, NULL);
     instruction->next = *code_list;
     *code_list = instruction;
 
     reset_temp_counter(); // Reset temps for the new function
 
-    Scope *function_body_scope = currentScope;
+    // The frame size for the declared locals was recorded by the parser;
+    // spill slots made while translating the body are added on top of it
+    current_function = function;
+    current_exit_label = NULL; // made by the first return
 
     debug_tac("Instruction Set");
-    make_TAC(node->child0, code_list);
+    make_TAC(func_def_body(node), code_list);
 
-    int total_local_bytes = abs(function_body_scope->current_offset) - 8;
-    if (total_local_bytes < 0)
-      total_local_bytes = 0;
+    // Every return jumps here
+    if (current_exit_label != NULL) {
+      current_exit_label->next = *code_list;
+      *code_list = current_exit_label;
+    }
 
-    // Store the calculated size in the function's symbol entry
-    left->local_var_bytes = total_local_bytes;
+    current_function = NULL;
+    current_exit_label = NULL;
 
     // Generate TAC_LEAVE
     op_type = TAC_LEAVE;
@@ -280,92 +484,58 @@ Symbol *make_TAC(ASTnode *node, Quad **code_list) {
     *code_list = instruction;
 
     return NULL;
+  }
 
-  case FUNC_CALL: {
-    debug_tac("FUNC_CALL");
-
-    Symbol *func_symbol = node->symbol;
-    Symbol *return_val_temp = NULL;
-    Quad *call_instr = NULL;
-    Quad *retrieve_instr = NULL;
-
-    make_TAC(node->child0, code_list);
-
-    bool returns_value = false;
-    if (returns_value) {
-      // E.place = newtemp(f.returnType);
-      return_val_temp = new_temp("variable");
-      assert(return_val_temp != NULL);
-    }
-
-    op_type = TAC_CALL;
-    src1 = new_operand(SYM_TABLE_PTR, func_symbol);
-    src2 = new_operand(INTEGER_CONSTANT, &(func_symbol->number_of_arguments));
-    call_instr = new_instr(op_type, src1, src2, NULL);
-
-    call_instr->next = *code_list;
-    *code_list = call_instr;
-
-    if (return_val_temp != NULL) {
-      op_type = TAC_RETRIEVE;
-      dest = new_operand(SYM_TABLE_PTR, return_val_temp);
-      retrieve_instr = new_instr(op_type, NULL, NULL, dest);
-
-      // Prepend RETRIEVE instruction (goes after CALL)
-      retrieve_instr->next = *code_list;
-      *code_list = retrieve_instr;
-    }
+  case FUNC_CALL:
+    return make_call(node, true, code_list);
 
-    return return_val_temp;
-  }
-  case STMT_LIST:
+  case STMT_LIST: {
     debug_tac("STMT_LIST");
-    make_TAC(node->child0, code_list);
-    make_TAC(node->child1, code_list);
+    int nstmts = stmt_list_length(node);
+    for (int i = 1; i <= nstmts; i++) {
+      make_stmt_TAC(stmt_list_nth(node, i), code_list);
+    }
     return NULL;
+  }
 
-  case EXPR_LIST:
+  case EXPR_LIST: {
     debug_tac("EXPR_LIST");
 
-    // We need to go through the params right to left
+    // Arguments are pushed right to left
+    int nargs = expr_list_length(node);
+    for (int i = nargs; i >= 1; i--) {
+      left = make_TAC(expr_list_nth(node, i), code_list);
 
-    // Recurse through right first
-    make_TAC(node->child1, code_list);
-
-    left = make_TAC(node->child0, code_list);
+      bool needs_load = false;
+      if (left && left->operand_type == SYM_TABLE_PTR &&
+          left->val.symbol_ptr->kind == SYMBOL_VARIABLE) {
+        needs_load = true;
+      }
 
-    bool needs_load = false;
-    if (left && left->type && strcmp(left->type, "variable") == 0 &&
-        left->name[0] != 't') {
-      needs_load = true;
-    }
+      Operand *param_to_use;
 
-    Symbol *param_symbol_to_use;
+      if (needs_load) {
+        Operand *temp_for_load = new_temp();
+        Quad *load_instr = new_instr(TAC_ASSIGN, left, NULL, temp_for_load);
 
-    if (needs_load) {
-      Symbol *temp_for_load = new_temp("variable");
+        load_instr->next = *code_list;
+        *code_list = load_instr;
 
-      Operand *dest_op = new_operand(SYM_TABLE_PTR, temp_for_load);
-      Operand *src_op = new_operand(SYM_TABLE_PTR, left);
-      Quad *load_instr = new_instr(TAC_ASSIGN, src_op, NULL, dest_op);
+        param_to_use = temp_for_load; // param t1
 
-      load_instr->next = *code_list;
-      *code_list = load_instr;
+      } else {
+        param_to_use = left;
+      }
 
-      param_symbol_to_use = temp_for_load; // param t1
+      op_type = TAC_PARAM;
+      instruction = new_instr(op_type, param_to_use, NULL, NULL);
 
-    } else {
-      param_symbol_to_use = left;
+      instruction->next = *code_list;
+      *code_list = instruction;
     }
 
-    op_type = TAC_PARAM;
-    src1 = new_operand(SYM_TABLE_PTR, param_symbol_to_use);
-    instruction = new_instr(op_type, src1, NULL, NULL);
-
-    instruction->next = *code_list;
-    *code_list = instruction;
-
     return NULL;
+  }
 
   case IF: {
     // If statement
@@ -377,11 +547,11 @@ Symbol *make_TAC(ASTnode *node, Quad **code_list) {
     Quad *Lelse = NULL;
     Quad *Lafter = new_label();
 
-    if (node->child2 != NULL) {
+    if (stmt_if_else(node) != NULL) {
       Lelse = new_label();
-      make_bool(node->child0, Lthen, Lelse, code_list);
+      make_bool(stmt_if_expr(node), Lthen, Lelse, Lthen, code_list);
     } else {
-      make_bool(node->child0, Lthen, Lafter, code_list);
+      make_bool(stmt_if_expr(node), Lthen, Lafter, Lthen, code_list);
     }
 
     // Emit Lthen label
@@ -389,10 +559,10 @@ Symbol *make_TAC(ASTnode *node, Quad **code_list) {
     *code_list = Lthen;
 
     // True state
-    make_TAC(node->child1, code_list);
+    make_stmt_TAC(stmt_if_then(node), code_list);
 
     // Handle the 'else' block if it exists
-    if (node->child2 != NULL) {
+    if (stmt_if_else(node) != NULL) {
 
       // Generate a jump to Lafter after the 'then' block so you don't enter
       // else block after completing true state
@@ -405,7 +575,7 @@ Symbol *make_TAC(ASTnode *node, Quad **code_list) {
       *code_list = Lelse;
 
       // False state
-      make_TAC(node->child2, code_list);
+      make_stmt_TAC(stmt_if_else(node), code_list);
     }
 
     // Emit the Lafter label
@@ -429,14 +599,14 @@ Symbol *make_TAC(ASTnode *node, Quad **code_list) {
 
     // Generate code for the boolean condition. If true, jump to Lbody; if
     // false, jump to Lafter.
-    make_bool(node->child0, Lbody, Lafter, code_list);
+    make_bool(stmt_while_expr(node), Lbody, Lafter, Lbody, code_list);
 
     // Emit the Lbody label before the loop body
     Lbody->next = *code_list;
     *code_list = Lbody;
 
     // Generate code for the body of the while loop
-    make_TAC(node->child1, code_list);
+    make_stmt_TAC(stmt_while_body(node), code_list);
 
     // Generate an unconditional jump back to the top of the loop (Ltop)
     Quad *gotoLtop = new_instr(TAC_GOTO, NULL, NULL, Ltop->src1);
@@ -451,22 +621,30 @@ Symbol *make_TAC(ASTnode *node, Quad **code_list) {
   }
   case RETURN: {
     debug_tac("RETURN");
-    Symbol *return_val_place = NULL;
+    Operand *return_val_place = NULL;
     Quad *set_retval_instr = NULL;
 
-    if (node->child0 != NULL) {
-      return_val_place = make_TAC(node->child0, code_list);
+    if (stmt_return_expr(node) != NULL) {
+      return_val_place = make_TAC(stmt_return_expr(node), code_list);
 
       assert(return_val_place != NULL);
 
-      Operand *retval_op = new_operand(SYM_TABLE_PTR, return_val_place);
       set_retval_instr = new_instr(TAC_SET_RETVAL /* Add this OpType */,
-                                   retval_op, NULL, NULL);
+                                   return_val_place, NULL, NULL);
 
       set_retval_instr->next = *code_list;
       *code_list = set_retval_instr;
     }
 
+    // Leave the function right away
+    if (current_exit_label == NULL) {
+      current_exit_label = new_label();
+    }
+    Quad *goto_exit =
+        new_instr(TAC_GOTO, NULL, NULL, current_exit_label->src1);
+    goto_exit->next = *code_list;
+    *code_list = goto_exit;
+
     return NULL;
   }
 
@@ -476,112 +654,53 @@ Symbol *make_TAC(ASTnode *node, Quad **code_list) {
   }
 }
 
+// Writes op as the quads show it: a name, a temporary or a constant
+static const char *operand_text(const Operand *op, char *buffer,
+                                size_t size) {
+  switch (op->operand_type) {
+  case SYM_TABLE_PTR:
+    return op->val.symbol_ptr->name;
+  case TEMP_REG:
+    snprintf(buffer, size, "t%d", op->val.temp);
+    return buffer;
+  case INTEGER_CONSTANT:
+  default:
+    snprintf(buffer, size, "%d", op->val.integer_const);
+    return buffer;
+  }
+}
+
 void print_quad(Quad *code_list) {
   if (code_list == NULL) {
     return;
   }
 
-  Operand *src1 = NULL;
-  Operand *src2 = NULL;
-  Operand *dest = NULL;
+  char text1[32];
+  char text2[32];
+  const char *op_text = NULL;
 
   switch (code_list->op) {
   case TAC_ADD:
-    src1 = code_list->src1;
-    src2 = code_list->src2;
-
-    if (src1->operand_type == SYM_TABLE_PTR) {
-      printf("%s", src1->val.symbol_ptr->name);
-    } else {
-      printf("%d", src1->val.integer_const);
-    }
-
-    printf(" + ");
-
-    if (src2->operand_type == SYM_TABLE_PTR) {
-      printf("%s\n", src2->val.symbol_ptr->name);
-    } else {
-      printf("%d\n", src2->val.integer_const);
-    }
-    break;
   case TAC_SUB:
-    src1 = code_list->src1;
-    src2 = code_list->src2;
-
-    if (src1->operand_type == SYM_TABLE_PTR) {
-      printf("%s", src1->val.symbol_ptr->name);
-    } else {
-      printf("%d", src1->val.integer_const);
-    }
-
-    printf(" - ");
-
-    if (src2->operand_type == SYM_TABLE_PTR) {
-      printf("%s\n", src2->val.symbol_ptr->name);
-    } else {
-      printf("%d\n", src2->val.integer_const);
-    }
-    break;
   case TAC_MUL:
-    src1 = code_list->src1;
-    src2 = code_list->src2;
-
-    if (src1->operand_type == SYM_TABLE_PTR) {
-      printf("%s", src1->val.symbol_ptr->name);
-    } else {
-      printf("%d", src1->val.integer_const);
-    }
-
-    printf(" x ");
-
-    if (src2->operand_type == SYM_TABLE_PTR) {
-      printf("%s\n", src2->val.symbol_ptr->name);
-    } else {
-      printf("%d\n", src2->val.integer_const);
-    }
-    break;
   case TAC_DIV:
-    src1 = code_list->src1;
-    src2 = code_list->src2;
-
-    if (src1->operand_type == SYM_TABLE_PTR) {
-      printf("%s", src1->val.symbol_ptr->name);
-    } else {
-      printf("%d", src1->val.integer_const);
-    }
-
-    printf(" / ");
-
-    if (src2->operand_type == SYM_TABLE_PTR) {
-      printf("%s\n", src2->val.symbol_ptr->name);
-    } else {
-      printf("%d\n", src2->val.integer_const);
-    }
+    op_text = (code_list->op == TAC_ADD)   ? "+"
+              : (code_list->op == TAC_SUB) ? "-"
+              : (code_list->op == TAC_MUL) ? "x"
+                                           : "/";
+    printf("%s %s %s\n", operand_text(code_list->src1, text1, sizeof(text1)),
+           op_text, operand_text(code_list->src2, text2, sizeof(text2)));
     break;
   case TAC_ASSIGN:
-    dest = code_list->dest;
-    src1 = code_list->src1;
-
-    printf("%s = ", dest->val.symbol_ptr->name);
-
-    if (src1->operand_type == SYM_TABLE_PTR) {
-      printf("%s\n", src1->val.symbol_ptr->name);
-    } else {
-      printf("%d\n", src1->val.integer_const);
-    }
-
+    printf("%s = %s\n", operand_text(code_list->dest, text1, sizeof(text1)),
+           operand_text(code_list->src1, text2, sizeof(text2)));
     break;
   case TAC_LABEL:
-    dest = code_list->dest;
-
-    printf("Label %s:\n", dest->val.symbol_ptr->name);
+    printf("Label L%d:\n", code_list->src1->val.integer_const);
     break;
   case TAC_CALL:
-    src1 = code_list->src1;
-    src2 = code_list->src2;
-
-    printf("call %s, %s\n", src1->val.symbol_ptr->name,
-           src2->val.symbol_ptr->name);
+    printf("call %s, %d\n", code_list->src1->val.symbol_ptr->name,
+           code_list->src2->val.integer_const);
     break;
   case TAC_PARAM:
   case TAC_ENTER:
@@ -636,6 +755,8 @@ char *quad_list_to_string(Quad *code_list) {
   size_t buffer_size = 0;
   size_t current_len = 0;
   char temp_instr_buffer[256];
+  char text1[32];
+  char text2[32];
 
   Quad *current = code_list;
   while (current != NULL) {
@@ -672,23 +793,19 @@ char *quad_list_to_string(Quad *code_list) {
 
     // TODO
     case TAC_ADD:
-      break;
-    case TAC_ASSIGN:
-      if (src1->operand_type == SYM_TABLE_PTR) {
-        snprintf(temp_instr_buffer, sizeof(temp_instr_buffer), "%s = %s\n",
-                 dest->val.symbol_ptr->name, src1->val.symbol_ptr->name);
-      } else {
-        snprintf(temp_instr_buffer, sizeof(temp_instr_buffer), "%s = %d\n",
-                 dest->val.symbol_ptr->name, src1->val.integer_const);
-      }
-      break;
-    case TAC_LABEL:
     case TAC_SUB:
     case TAC_MUL:
     case TAC_DIV:
+    case TAC_LABEL:
+      break;
+    case TAC_ASSIGN:
+      snprintf(temp_instr_buffer, sizeof(temp_instr_buffer), "%s = %s\n",
+               operand_text(dest, text1, sizeof(text1)),
+               operand_text(src1, text2, sizeof(text2)));
+      break;
     case TAC_PARAM:
       snprintf(temp_instr_buffer, sizeof(temp_instr_buffer), "param %s\n",
-               src1->val.symbol_ptr->name);
+               operand_text(src1, text1, sizeof(text1)));
       break;
     case TAC_CALL:
       snprintf(temp_instr_buffer, sizeof(temp_instr_buffer), "call %s, %d\n",
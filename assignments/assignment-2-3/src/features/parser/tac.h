@@ -39,14 +39,17 @@ typedef enum {
 typedef enum {
   INTEGER_CONSTANT,
   SYM_TABLE_PTR,
+  TEMP_REG,
 } OperandType;
 
+// A TEMP_REG operand is a temporary, numbered from 0 in each function. It has
+// no symbol; the backend gives it one of $t0-$t7 while it is live.
 typedef struct {
   OperandType operand_type;
   union {
     int integer_const;
     Symbol *symbol_ptr;
-    char *id_name;
+    int temp;
   } val;
 } Operand;
 
@@ -58,10 +61,23 @@ typedef struct tac {
   struct tac *next; // Link to the next instruction.
 } Quad;
 
-Symbol *make_TAC(ASTnode *node, Quad **code_list);
+/*
+ * Makes arena the allocator for the quads, operands and spill slots created
+ * by make_TAC() on this thread (NULL: malloc) and returns the previous one.
+ * Destroying the arena then frees a function's TAC in one go.
+ */
+ASTArena *tac_use_arena(ASTArena *arena);
+
+// Appends the code for node to code_list, newest quad first. Returns where an
+// expression's value is, or NULL for a statement.
+Operand *make_TAC(void *node, Quad **code_list);
 Quad *reverse_tac_list(Quad *head);
+// Adds a word to the bottom of function's frame, growing its
+// local_var_bytes, and returns the word's offset from $fp
+int new_frame_slot(Symbol *function);
 void print_quad(Quad *code_list);
 char *quad_list_to_string(Quad *code_list);
 void reset_temp_counter();
+void reset_label_counter();
 
 #endif
@@ -85,6 +85,15 @@ TokenI getNextToken(void) {
   case opGT:
     token.type = TOKEN_OPGT;
     break;
+  case opAND:
+    token.type = TOKEN_OPAND;
+    break;
+  case opOR:
+    token.type = TOKEN_OPOR;
+    break;
+  case opNOT:
+    token.type = TOKEN_OPNOT;
+    break;
   default:
     token.type = TOKEN_UNDEF;
     break;
@@ -26,6 +26,9 @@ typedef enum {
   TOKEN_OPLT,
   TOKEN_OPGE,
   TOKEN_OPGT,
+  TOKEN_OPAND,
+  TOKEN_OPOR,
+  TOKEN_OPNOT,
 } TokenType;
 
 typedef struct {
@@ -0,0 +1,75 @@
+// Measures symbol table inserts and lookups as the number of globals grows
+// from 10 to 10^6. Lookups are made from a function's scope, so each one
+// misses there before it finds its global, as identifier references do.
+#include "../src/features/parser/symbol_table.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define LOCALS 8
+#define LOOKUPS 1000000
+
+Scope *globalScope = NULL;
+Scope *currentScope = NULL;
+
+static double seconds_now(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (double)now.tv_sec + (double)now.tv_nsec / 1e9;
+}
+
+static void bench(int globals) {
+  char name[32];
+
+  initSymbolTable();
+  double start = seconds_now();
+  for (int i = 0; i < globals; i++) {
+    snprintf(name, sizeof(name), "g%d", i);
+    add_variable_symbol(name);
+  }
+  double insert_seconds = seconds_now() - start;
+
+  pushScope();
+  for (int i = 0; i < LOCALS; i++) {
+    snprintf(name, sizeof(name), "l%d", i);
+    add_variable_symbol(name);
+  }
+
+  // The names are made up front so only the lookups are timed
+  char(*names)[32] = malloc(LOOKUPS * sizeof(*names));
+  if (!names) {
+    fprintf(stderr, "ERROR: Memory allocation failed\n");
+    exit(1);
+  }
+  unsigned int seed = 12345;
+  for (int i = 0; i < LOOKUPS; i++) {
+    seed = seed * 1103515245u + 12345u;
+    snprintf(names[i], sizeof(names[i]), "g%u", (seed >> 8) % globals);
+  }
+
+  int found = 0;
+  start = seconds_now();
+  for (int i = 0; i < LOOKUPS; i++) {
+    found += lookup_symbol_in_table(names[i], SYMBOL_VARIABLE) != NULL;
+  }
+  double lookup_seconds = seconds_now() - start;
+
+  if (found != LOOKUPS) {
+    fprintf(stderr, "ERROR: %d of %d lookups failed\n", LOOKUPS - found,
+            LOOKUPS);
+    exit(1);
+  }
+
+  printf("%8d globals: %8.1f ns/insert %8.1f ns/lookup\n", globals,
+         insert_seconds * 1e9 / globals, lookup_seconds * 1e9 / LOOKUPS);
+
+  free(names);
+  free_symbol_table();
+}
+
+int main(void) {
+  for (int globals = 10; globals <= 1000000; globals *= 10) {
+    bench(globals);
+  }
+  return 0;
+}
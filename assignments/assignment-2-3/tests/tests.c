@@ -1,18 +1,43 @@
 #include "../src/features/parser/ast.h"
+#include "../src/features/parser/ast_dump.h"
+#include "../src/features/parser/ast_file.h"
+#include "../src/features/parser/ast_stats.h"
+#include "../src/features/parser/ast_store.h"
+#include "../src/features/parser/fold.h"
 #include "../src/features/parser/grammar_rule.h"
+#include "../src/features/parser/inline.h"
+#include "../src/features/parser/interp.h"
 #include "../src/features/parser/mips.h"
+#include "../src/features/parser/pure_eval.h"
+#include "../src/features/parser/sym_file.h"
+#include "../src/features/parser/symbol_registry.h"
 #include "../src/features/parser/symbol_table.h"
 #include "../src/features/parser/tac.h"
 #include "../src/features/parser/token_service.h"
 #include "../src/features/scanner/scanner.h"
 #include <assert.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
 int chk_decl_flag = 0;
 int print_ast_flag = 0;
 int gen_code_flag = 0;
+int pipeline_flag = 0;
+int compact_ast_flag = 0;
+int stream_flag = 0;
+int fold_flag = 0;
+int hash_cons_flag = 0;
+int run_flag = 0;
+int ast_stats_flag = 0;
+int inline_flag = 0;
+char *save_ast_dir = NULL;
+char *export_sym_path = NULL;
+char **import_sym_paths = NULL;
+int import_sym_count = 0;
+ASTDumpFormat ast_format = AST_DUMP_TEXT;
 
 ASTnode *build_ast_for_quad_test(char *test_src) {
   chk_decl_flag = 1;
@@ -20,6 +45,7 @@ ASTnode *build_ast_for_quad_test(char *test_src) {
   initSymbolTable();
   init_grammar_rules();
   reset_temp_counter();
+  reset_label_counter();
 
   scanner_init_with_string(test_src);
 
@@ -293,6 +319,490 @@ void test_quad_global_variable() {
   free(actual_output_string);
 }
 
+void test_quad_temps_per_function() {
+  ASTnode *f = build_ast_for_quad_test("int f() { println(7); }");
+  Quad *code_list = NULL;
+  make_TAC(f, &code_list);
+
+  ASTnode *g = continue_ast("int g() { println(8); }");
+  make_TAC(g, &code_list);
+  code_list = reverse_tac_list(code_list);
+
+  // Each function numbers its temporaries from 0, and a quad using one
+  // shares the operand of the quad that set it
+  int functions = 0;
+  for (Quad *q = code_list; q != NULL; q = q->next) {
+    if (q->op == TAC_ASSIGN) {
+      assert(q->dest->operand_type == TEMP_REG && q->dest->val.temp == 0);
+      assert(q->next->op == TAC_PARAM && q->next->src1 == q->dest);
+      functions++;
+    }
+  }
+  assert(functions == 2);
+}
+
+void test_quad_fold_constant_branches() {
+  char *test_source_code = "int main() { int x; x = 1; "
+                           "if (2 < 1) x = 2; else x = 3; "
+                           "while (0 > 1) x = 4; if (x == x) x = 5; }";
+  ASTnode *ast_input = build_ast_for_quad_test(test_source_code);
+  ast_input = fold_constants(ast_input);
+
+  Quad *actual_code_list = NULL;
+  make_TAC(ast_input, &actual_code_list);
+  actual_code_list = reverse_tac_list(actual_code_list);
+
+  char *actual_output_string = NULL;
+  actual_output_string = quad_list_to_string(actual_code_list);
+
+  // Only the branches that can run are left
+  const char *expected_output_string = "enter main\n"
+                                       "t0 = 1\n"
+                                       "x = t0\n"
+                                       "t1 = 3\n"
+                                       "x = t1\n"
+                                       "t2 = 5\n"
+                                       "x = t2\n"
+                                       "leave main\n"
+                                       "return\n";
+
+  assert(strcmp(actual_output_string, expected_output_string) == 0);
+
+  free(actual_output_string);
+}
+
+void test_quad_constant_branch_needs_fold() {
+  // Only --fold turns a comparison of constants into a jump
+  char *test_source_code = "int main() { int x; if (2 < 1) x = 2; }";
+  ASTnode *ast_input = build_ast_for_quad_test(test_source_code);
+
+  Quad *code_list = NULL;
+  make_TAC(ast_input, &code_list);
+  char *unfolded = mips_list_to_string(
+      generate_mips_text(reverse_tac_list(code_list)));
+  assert(strstr(unfolded, "    bge $t0, $t1, _L1\n") != NULL);
+
+  fold_flag = 1;
+  code_list = NULL;
+  make_TAC(ast_input, &code_list);
+  fold_flag = 0;
+  char *folded = mips_list_to_string(
+      generate_mips_text(reverse_tac_list(code_list)));
+  assert(strstr(folded, "bge") == NULL);
+  assert(strstr(folded, "    j _L3\n") != NULL);
+
+  free(unfolded);
+  free(folded);
+}
+
+void test_ast_hash_consing() {
+  ASTArena *arena = ast_arena_create();
+  ast_arena_set_hash_consing(arena, true);
+  ASTArena *previous_arena = ast_arena_use(arena);
+
+  Symbol x_symbol = {.name = "x", .kind = SYMBOL_VARIABLE};
+  Symbol f_symbol = {.name = "f", .kind = SYMBOL_FUNCTION};
+
+  ASTnode *first = create_lt_node(create_identifier_node(&x_symbol),
+                                  create_intconst_node(3));
+  ASTnode *second = create_lt_node(create_identifier_node(&x_symbol),
+                                   create_intconst_node(3));
+  assert(first == second);
+  assert(first != create_le_node(first->child0, first->child1));
+
+  // Calls are never shared, and neither is anything above them
+  ASTnode *call = create_func_call_node(&f_symbol, NULL);
+  assert(call != create_func_call_node(&f_symbol, NULL));
+  assert(create_lt_node(call, create_intconst_node(3)) !=
+         create_lt_node(call, create_intconst_node(3)));
+
+  assert(ast_arena_shared_count(arena) == 5);
+
+  ast_arena_use(previous_arena);
+  ast_arena_destroy(arena);
+}
+
+void test_ast_file_round_trip() {
+  char *test_source_code = "int f(int a, int b) { if (a < b) return f(b, a); "
+                           "return a; }";
+  ASTnode *ast_input = build_ast_for_quad_test(test_source_code);
+
+  ASTStore *store = ast_store_build(ast_input);
+  char path[] = "/tmp/ast_file_testXXXXXX";
+  int fd = mkstemp(path);
+  assert(fd >= 0);
+  close(fd);
+  assert(ast_file_write(store, path));
+
+  ASTStore *loaded = ast_file_load(path);
+  assert(loaded != NULL);
+  unlink(path);
+
+  // The tree is read from the mapped file in place
+  assert(loaded->node_count == store->node_count);
+  assert(memcmp(loaded->kind, store->kind, store->node_count) == 0);
+  assert(memcmp(loaded->child0, store->child0,
+                store->node_count * sizeof(uint32_t)) == 0);
+
+  ASTStore *previous_store = ast_store_bind(loaded);
+  void *root = ast_store_root(loaded);
+  assert(strcmp(func_def_name(root), "f") == 0);
+  assert(func_def_nargs(root) == 2);
+  assert(strcmp(func_def_argname(root, 2), "b") == 0);
+  ast_store_bind(previous_store);
+
+  ast_store_destroy(loaded);
+  ast_store_destroy(store);
+}
+
+void test_sym_file_import() {
+  ASTnode *f = build_ast_for_quad_test(
+      "int g; int f(int a, int b) { return a; }");
+  assert(f != NULL);
+  char path[] = "/tmp/sym_file_testXXXXXX";
+  int fd = mkstemp(path);
+  assert(fd >= 0);
+  close(fd);
+  assert(sym_file_write(globalScope, path));
+
+  // A unit that calls f and sets g without their source
+  initSymbolTable();
+  assert(sym_file_import(path));
+  assert(sym_file_import(path)); // the same signatures again are no conflict
+  Symbol *imported = lookup_symbol_in_table("f", SYMBOL_FUNCTION);
+  assert(imported != NULL && imported->number_of_arguments == 2);
+  assert(imported->flags == (SYMBOL_GLOBAL | SYMBOL_EXTERN));
+  ASTnode *main_def = continue_ast("int main() { g = f(g, 2); }");
+  assert(main_def->child0->items[0]->child0->symbol ==
+         lookup_symbol_in_table("g", SYMBOL_VARIABLE));
+
+  // Its own symbols are exported without the imported ones
+  assert(sym_file_write(globalScope, path));
+  initSymbolTable();
+  assert(sym_file_import(path));
+  assert(lookup_symbol_in_table("main", SYMBOL_FUNCTION) != NULL);
+  assert(lookup_symbol_in_table("f", SYMBOL_FUNCTION) == NULL);
+
+  // A name declared as something else is a conflict
+  initSymbolTable();
+  assert(add_variable_symbol("main"));
+  assert(!sym_file_import(path));
+
+  // So is a function another unit imported with a different arity
+  build_ast_for_quad_test("int f(int a) { return a; }");
+  assert(sym_file_write(globalScope, path));
+  initSymbolTable();
+  assert(!sym_file_import(path));
+  unlink(path);
+  symbol_registry_free();
+}
+
+static char *dump_to_string(void *tree, ASTDumpFormat format) {
+  char path[] = "/tmp/ast_dump_testXXXXXX";
+  int fd = mkstemp(path);
+  assert(fd >= 0);
+  unlink(path);
+
+  ASTDumper *dumper = ast_dumper_create(fd, format);
+  ast_dump(dumper, tree);
+  ast_dumper_destroy(dumper);
+
+  off_t size = lseek(fd, 0, SEEK_END);
+  char *text = calloc((size_t)size + 1, 1);
+  assert(pread(fd, text, (size_t)size, 0) == size);
+  close(fd);
+  return text;
+}
+
+void test_ast_dump_formats() {
+  char *test_source_code = "int f(int a) { int x; x = f(2); "
+                           "while (x > 0 && !(a == 1)) x = f(x); "
+                           "return x; }";
+  ASTnode *ast_input = build_ast_for_quad_test(test_source_code);
+
+  char *sexpr = dump_to_string(ast_input, AST_DUMP_SEXPR);
+  assert(strcmp(sexpr, "(func f (a) (block (= x (call f 2)) "
+                       "(while (&& (> x 0) (! (== a 1))) (= x (call f x))) "
+                       "(return x)))\n") == 0);
+
+  char *json = dump_to_string(ast_input, AST_DUMP_JSON);
+  char *json_start = "{\"kind\":\"FUNC_DEF\",\"name\":\"f\","
+                     "\"formals\":[\"a\"],\"body\":{\"kind\":\"STMT_LIST\","
+                     "\"items\":[{\"kind\":\"ASSG\"";
+  assert(strncmp(json, json_start, strlen(json_start)) == 0);
+  assert(strchr(json, '\n') == json + strlen(json) - 1);
+
+  free(json);
+  free(sexpr);
+}
+
+void test_ast_stats_shape() {
+  char *test_source_code = "int f(int a) { if (a < 1) f(a); "
+                           "while (a > 2) { f(a); f(3); } return a; }";
+  ASTnode *ast_input = build_ast_for_quad_test(test_source_code);
+
+  ASTStats stats;
+  ast_stats_collect(ast_input, &stats);
+
+  assert(stats.node_count[FUNC_CALL] == 3);
+  assert(stats.node_count[IDENTIFIER] == 5);
+  assert(stats.node_count[STMT_LIST] == 2);
+  assert(stats.nodes == 22);
+  // FUNC_DEF, STMT_LIST, WHILE, STMT_LIST, FUNC_CALL, EXPR_LIST, IDENTIFIER
+  assert(stats.max_depth == 7);
+  assert(stats.lists == 5);
+  assert(stats.list_items == 8);
+  assert(stats.longest_list == 3);
+}
+
+void test_inline_small_call() {
+  ASTnode *callee = build_ast_for_quad_test("int id(int a) { return a; }");
+  inline_register(callee);
+
+  ASTnode *caller = continue_ast("int main() { int x; x = id(4); "
+                                 "println(id(x)); }");
+  assert(caller->symbol->local_var_bytes == 8);
+  inline_calls(caller);
+  inline_reset();
+
+  // The call in the argument of println stays
+  char *sexpr = dump_to_string(caller, AST_DUMP_SEXPR);
+  assert(strcmp(sexpr, "(func main () (block (block (= a@id 4) (= x a@id)) "
+                       "(call println (call id x))))\n") == 0);
+  assert(caller->symbol->local_var_bytes == 12);
+  free(sexpr);
+}
+
+void test_pure_eval_constant_call() {
+  ASTnode *callee = build_ast_for_quad_test(
+      "int pick(int a, int b) { if (a < b) return b; return a; }");
+  pure_eval_register(callee);
+
+  ASTnode *caller = continue_ast("int main() { int x; "
+                                 "x = pick(pick(9, 1), 4); pick(2, 3); "
+                                 "println(pick(x, 5)); }");
+  pure_eval_calls(caller);
+  pure_eval_reset();
+
+  // Calls with a non-constant argument and call statements stay
+  char *sexpr = dump_to_string(caller, AST_DUMP_SEXPR);
+  assert(strcmp(sexpr, "(func main () (block (= x 9) (call pick 2 3) "
+                       "(call println (call pick x 5))))\n") == 0);
+  free(sexpr);
+}
+
+void test_symbol_table_scopes() {
+  char name[16];
+  initSymbolTable();
+  // Enough globals for the scope's table to grow several times
+  for (int i = 0; i < 1000; i++) {
+    snprintf(name, sizeof(name), "g%d", i);
+    assert(add_variable_symbol(name));
+  }
+
+  pushScope();
+  assert(add_variable_symbol("g7"));
+  Symbol *local = lookup_symbol_in_table("g7", SYMBOL_VARIABLE);
+  assert(local != NULL && local->flags == SYMBOL_LOCAL);
+  Symbol *global = lookup_symbol_in_scope("g7", SYMBOL_VARIABLE, globalScope);
+  assert(global != NULL && global->flags == SYMBOL_GLOBAL);
+  assert(lookup_symbol_in_table("g999", SYMBOL_VARIABLE)->flags ==
+         SYMBOL_GLOBAL);
+  assert(lookup_symbol_in_table("g1000", SYMBOL_VARIABLE) == NULL);
+  assert(lookup_symbol_in_table("println", SYMBOL_FUNCTION) != NULL);
+  assert(lookup_symbol_in_table("println", SYMBOL_VARIABLE) == NULL);
+  assert(check_duplicate_symbol_in_scope("g7", currentScope));
+  assert(!check_duplicate_symbol_in_scope("g8", currentScope));
+
+  popScope();
+  assert(lookup_symbol_in_table("g7", SYMBOL_VARIABLE) == global);
+  // The list still starts with the newest symbol
+  assert(strcmp(globalScope->symbols->name, "g999") == 0);
+}
+
+void test_symbol_index() {
+  static Symbol symbols[200];
+  SymbolIndex map = {0};
+  assert(symbol_index_get(&map, &symbols[0]) == -1);
+
+  // Enough symbols to grow the map twice
+  for (int i = 0; i < 200; i++) {
+    symbol_index_put(&map, &symbols[i], i);
+  }
+  symbol_index_put(&map, &symbols[7], 70);
+  assert(map.count == 200);
+  assert(symbol_index_get(&map, &symbols[7]) == 70);
+  assert(symbol_index_get(&map, &symbols[199]) == 199);
+
+  Symbol other = {0};
+  assert(symbol_index_get(&map, &other) == -1);
+  symbol_index_free(&map);
+  assert(symbol_index_get(&map, &symbols[7]) == -1);
+}
+
+#define REGISTRY_THREADS 4
+#define REGISTRY_NAMES 500
+#define REGISTRY_FUNCTIONS 100
+
+typedef struct {
+  int id;
+  const char *names[REGISTRY_NAMES];
+  const Symbol *signatures[REGISTRY_FUNCTIONS];
+} RegistryWorker;
+
+static void *registry_worker(void *arg) {
+  RegistryWorker *worker = arg;
+  char name[16];
+  // Each thread starts somewhere else, so they race on different slots
+  for (int n = 0; n < REGISTRY_NAMES; n++) {
+    int i = (n + worker->id * REGISTRY_NAMES / REGISTRY_THREADS) %
+            REGISTRY_NAMES;
+    snprintf(name, sizeof(name), "n%d", i);
+    worker->names[i] = intern_name(name);
+  }
+  for (int i = 0; i < REGISTRY_FUNCTIONS; i++) {
+    Symbol function = {0};
+    snprintf(name, sizeof(name), "f%d", i);
+    function.name = name;
+    function.kind = SYMBOL_FUNCTION;
+    function.number_of_arguments = i % 3;
+    worker->signatures[i] = register_function_signature(&function);
+  }
+  return NULL;
+}
+
+void test_symbol_registry_threads() {
+  static RegistryWorker workers[REGISTRY_THREADS];
+  pthread_t threads[REGISTRY_THREADS];
+  for (int t = 0; t < REGISTRY_THREADS; t++) {
+    workers[t].id = t;
+    assert(pthread_create(&threads[t], NULL, registry_worker, &workers[t]) ==
+           0);
+  }
+  for (int t = 0; t < REGISTRY_THREADS; t++) {
+    pthread_join(threads[t], NULL);
+  }
+
+  // Every thread got the same copy of each name and signature, though the
+  // names outgrew the first level of the table
+  assert(symbol_registry_name_count() == REGISTRY_NAMES + REGISTRY_FUNCTIONS);
+  for (int t = 1; t < REGISTRY_THREADS; t++) {
+    assert(memcmp(workers[t].names, workers[0].names,
+                  sizeof(workers[0].names)) == 0);
+    assert(memcmp(workers[t].signatures, workers[0].signatures,
+                  sizeof(workers[0].signatures)) == 0);
+  }
+  assert(strcmp(workers[0].names[42], "n42") == 0);
+  assert(intern_name("n42") == workers[0].names[42]);
+  const Symbol *f7 = lookup_function_signature("f7");
+  assert(f7 == workers[0].signatures[7]);
+  assert(f7->name == intern_name("f7"));
+  assert(f7->number_of_arguments == 1);
+  assert(lookup_function_signature("n7") == NULL);
+
+  // Another arity for a registered name is refused
+  Symbol clash = {0};
+  clash.name = "f7";
+  clash.kind = SYMBOL_FUNCTION;
+  clash.number_of_arguments = 2;
+  assert(register_function_signature(&clash) == NULL);
+  assert(lookup_function_signature("f7") == f7);
+  symbol_registry_free();
+}
+
+void test_parser_formal_references() {
+  ASTnode *func = build_ast_for_quad_test(
+      "int f(int a, int b) { int c; a = b; c = a; }");
+  Symbol *a = func->symbol->arguments;
+  Symbol *b = a->next;
+  assert(a->offset == 8 && b->offset == 12);
+
+  // Both uses of a name its formal, and the frame holds only c
+  ASTnode *first = func->child0->items[0];
+  ASTnode *second = func->child0->items[1];
+  assert(first->child0->symbol == a && first->child1->symbol == b);
+  assert(second->child0->symbol->offset == -8);
+  assert(second->child1->symbol == a);
+  assert(func->symbol->local_var_bytes == 8);
+}
+
+void test_parser_call_arity() {
+  ASTnode *func = build_ast_for_quad_test(
+      "int f(int a, int b) { f(f(a, 1), f(2, b)); return f(b, a); }");
+
+  // Checking the calls leaves the arity alone
+  assert(func->symbol->number_of_arguments == 2);
+  ASTnode *call = func->child0->items[0];
+  assert(expr_list_length(func_call_args(call)) == 2);
+}
+
+void test_interp_run() {
+  char *test_source_code = "int g; "
+                           "int pick(int a, int b) { if (a < b) return b; "
+                           "a = b; return a; } "
+                           "int main() { int i; g = pick(3, 9); println(g); "
+                           "i = 0; while (i != 2) { println(i); i = 2; } "
+                           "println(pick(9, 4)); }";
+  run_flag = 1;
+  build_ast_for_quad_test(test_source_code);
+  run_flag = 0;
+
+  FILE *out = tmpfile();
+  assert(out != NULL);
+  unsigned long statements = 0;
+  assert(interp_run(out, &statements));
+  interp_reset();
+
+  char text[64] = {0};
+  rewind(out);
+  assert(fread(text, 1, sizeof(text) - 1, out) > 0);
+  fclose(out);
+
+  assert(strcmp(text, "9\n0\n4\n") == 0);
+  assert(statements == 12);
+}
+
+void test_interp_matches_codegen_order() {
+  // a() prints its argument and leaves it in g, so the output shows the order
+  // of the calls and the comparison sees g after or before a(7)
+  char *test_source_code = "int g; "
+                           "int a(int x) { g = x; println(x); return 5; } "
+                           "int h(int x, int y) { return 0; } "
+                           "int main() { h(a(1), a(2)); "
+                           "if (g < a(7)) println(0); println(g); }";
+  run_flag = 1;
+  ASTnode *main_def = build_ast_for_quad_test(test_source_code);
+  run_flag = 0;
+
+  // The generated code pushes a(2) before a(1) and calls a(7) before g is
+  // loaded for the comparison
+  Quad *code_list = NULL;
+  make_TAC(main_def, &code_list);
+  code_list = reverse_tac_list(code_list);
+  char *mips = mips_list_to_string(generate_mips_text(code_list));
+  char *call_2 = strstr(mips, "    li $t0, 2\n");
+  char *call_1 = strstr(mips, "    li $t0, 1\n");
+  char *call_7 = strstr(mips, "    li $t0, 7\n");
+  char *load_g = strstr(mips, "    lw $t8, _g\n");
+  assert(call_2 && call_1 && call_7 && load_g);
+  assert(call_2 < call_1 && call_1 < call_7 && call_7 < load_g);
+  free(mips);
+
+  // The compiled program prints 2 1 7 7, and so must the interpreter
+  FILE *out = tmpfile();
+  assert(out != NULL);
+  unsigned long statements = 0;
+  assert(interp_run(out, &statements));
+  interp_reset();
+
+  char text[64] = {0};
+  rewind(out);
+  assert(fread(text, 1, sizeof(text) - 1, out) > 0);
+  fclose(out);
+
+  assert(strcmp(text, "2\n1\n7\n7\n") == 0);
+}
+
 void test_mips_func_defn() {
   char *test_src = "int f() { }";
 
@@ -461,6 +971,48 @@ void test_mips_assign_global_variable() {
   assert(strcmp(expected_output_string, actual_output_string) == 0);
 }
 
+void test_mips_global_named_like_temp() {
+
+  char *test_src = "int t1; int main() { t1 = 10; } ";
+
+  ASTnode *actual_ast = build_ast_for_quad_test(test_src);
+
+  Quad *actual_code_list = NULL;
+  make_TAC(actual_ast, &actual_code_list);
+  actual_code_list = reverse_tac_list(actual_code_list);
+
+  MipsInstruction *mips_list = NULL;
+  mips_list = generate_mips(actual_code_list);
+
+  char *actual_output_string = NULL;
+  actual_output_string = mips_list_to_string(mips_list);
+
+  // t1 is a global, not the register $t1
+  char *expected_output_string = ".data\n"
+                                 ".align 2\n"
+                                 "_t1: .space 4\n"
+                                 ".text\n"
+                                 "_main:\n"
+                                 "    la $sp, -8($sp)\n"
+                                 "    sw $fp, 4($sp)\n"
+                                 "    sw $ra, 0($sp)\n"
+                                 "    la $fp, 0($sp)\n"
+
+                                 "    li $t0, 10\n"
+                                 "    sw $t0, _t1\n"
+
+                                 "    la $sp, 0($fp)\n"
+                                 "    lw $ra, 0($sp)\n"
+                                 "    lw $fp, 4($sp)\n"
+                                 "    la $sp, 8($sp)\n"
+
+                                 "    jr $ra\n"
+
+                                 "\nmain: j _main\n";
+
+  assert(strcmp(expected_output_string, actual_output_string) == 0);
+}
+
 void test_mips_multiple_variables_and_println() {
   char *test_src = "int x, y, z; int main() { x = 12345; println(x); y = "
                    "23456; println(y); z = 34567; println(z); }";
@@ -495,31 +1047,31 @@ void test_mips_multiple_variables_and_println() {
                                  "    sw $t0, _x\n"
 
                                  // println(x)
-                                 "    lw $t1, _x\n"
+                                 "    lw $t0, _x\n"
                                  "    la $sp, -4($sp)\n"
-                                 "    sw $t1, 0($sp)\n"
+                                 "    sw $t0, 0($sp)\n"
                                  "    jal _println\n"
                                  "    la $sp, 4($sp)\n"
 
                                  // y = 23456
-                                 "    li $t2, 23456\n"
-                                 "    sw $t2, _y\n"
+                                 "    li $t0, 23456\n"
+                                 "    sw $t0, _y\n"
 
                                  // println(y)
-                                 "    lw $t3, _y\n"
+                                 "    lw $t0, _y\n"
                                  "    la $sp, -4($sp)\n"
-                                 "    sw $t3, 0($sp)\n"
+                                 "    sw $t0, 0($sp)\n"
                                  "    jal _println\n"
                                  "    la $sp, 4($sp)\n"
 
                                  // z = 34567
-                                 "    li $t4, 34567\n"
-                                 "    sw $t4, _z\n"
+                                 "    li $t0, 34567\n"
+                                 "    sw $t0, _z\n"
 
                                  // println(z)
-                                 "    lw $t5, _z\n"
+                                 "    lw $t0, _z\n"
                                  "    la $sp, -4($sp)\n"
-                                 "    sw $t5, 0($sp)\n"
+                                 "    sw $t0, 0($sp)\n"
                                  "    jal _println\n"
                                  "    la $sp, 4($sp)\n"
 
@@ -582,10 +1134,10 @@ void test_mips_function_call_println() {
                                  "    sw $ra, 0($sp)\n"
                                  "    la $fp, 0($sp)\n"
 
-                                 "    lw $t0, 8($fp)\n"
+                                 "    lw $t8, 8($fp)\n"
 
                                  "    la $sp, -4($sp)\n"
-                                 "    sw $t0, 0($sp)\n"
+                                 "    sw $t8, 0($sp)\n"
                                  "    jal _println\n"
                                  "    la $sp, 4($sp)\n"
 
@@ -663,24 +1215,23 @@ void test_mips_if_stmt() {
                                  "    sw $fp, 4($sp)\n"
                                  "    sw $ra, 0($sp)\n"
                                  "    la $fp, 0($sp)\n"
+                                 "    la $sp, -12($fp)\n"
 
                                  "    li $t0, 5\n"
                                  "    sw $t0, -8($fp)\n"
 
-                                 "    li $t1, 5\n"
-                                 "    sw $t1, -12($fp)\n"
-
-                                 "    lw $t0, -8($fp)\n"
-                                 "    lw $t1, -12($fp)\n"
-                                 "    beq $t0, $t1, _L0\n"
+                                 "    li $t0, 5\n"
+                                 "    sw $t0, -12($fp)\n"
 
-                                 "    j _L1\n"
+                                 "    lw $t8, -8($fp)\n"
+                                 "    lw $t9, -12($fp)\n"
+                                 "    bne $t8, $t9, _L1\n"
 
                                  "_L0:\n"
 
-                                 "    lw $t2, -8($fp)\n"
+                                 "    lw $t0, -8($fp)\n"
                                  "    la $sp, -4($sp)\n"
-                                 "    sw $t2, 0($sp)\n"
+                                 "    sw $t0, 0($sp)\n"
                                  "    jal _println\n"
                                  "    la $sp, 4($sp)\n"
 
@@ -739,29 +1290,28 @@ void test_mips_while_statement() {
       "    sw $fp, 4($sp)\n"   // Prologue: Save old $fp
       "    sw $ra, 0($sp)\n"   // Prologue: Save $ra
       "    la $fp, 0($sp)\n"   // Prologue: Set new $fp
-      "    la $sp, -24($sp)\n" // Prologue: Allocate space locals/temps (1 var +
-                               // 5 temps = 6 * 4)
+      "    la $sp, -8($fp)\n" // Prologue: Allocate space for x
       // x = 0; (TAC: t0=0; x=t0;)
       "    li $t0, 0\n"
       "    sw $t0, -8($fp)\n" // x = t0 (assuming x @ -8($fp))
       // Loop Start
       "_L0:\n" // Ltop
-      // Condition x < 3 (TAC: t1=x; t2=3; if_lt t1, t2, L1; goto L2;)
-      "    lw $t1, -8($fp)\n"   // t1 = x
-      "    li $t2, 3\n"         // t2 = 3
-      "    blt $t1, $t2, _L1\n" // if t1 < t2 goto Lbody (_L1)
-      "    j _L2\n"             // else goto Lafter (_L2)
+      // Condition x < 3 (TAC: t1=3; if_ge x, t1, L2;), falls into the body.
+      // t0 is dead by now, so t1 reuses $t0.
+      "    li $t0, 3\n"         // t1 = 3
+      "    lw $t8, -8($fp)\n"   // load x into a scratch register
+      "    bge $t8, $t0, _L2\n" // if x >= t1 goto Lafter (_L2)
       // Loop Body
       "_L1:\n" // Lbody
-      // println(5); (TAC: t3=5; param t3; call println, 1;)
-      "    li $t3, 5\n"       // t3 = 5 (Argument)
+      // println(5); (TAC: t2=5; param t2; call println, 1;)
+      "    li $t0, 5\n"       // t2 = 5 (Argument)
       "    la $sp, -4($sp)\n" // Push param space
-      "    sw $t3, 0($sp)\n"  // Push t3 (the value 5)
+      "    sw $t0, 0($sp)\n"  // Push t2 (the value 5)
       "    jal _println\n"    // Call println
       "    la $sp, 4($sp)\n"  // Pop param space
-      // x = 5; (TAC: t4=5; x=t4;)
-      "    li $t4, 5\n"       // t4 = 5
-      "    sw $t4, -8($fp)\n" // x = t4
+      // x = 5; (TAC: t3=5; x=t3;)
+      "    li $t0, 5\n"       // t3 = 5
+      "    sw $t0, -8($fp)\n" // x = t3
       "    j _L0\n"           // goto Ltop (_L0)
       // After Loop
       "_L2:\n" // Lafter
@@ -794,6 +1344,105 @@ void test_mips_while_statement() {
   free(actual_output_string);
 }
 
+void test_mips_temps_share_registers() {
+  // Ten temporaries, none live at the same time as another, all fit in $t0
+  char *test_src = "int main() { int x; x = 1; x = 2; x = 3; x = 4; x = 5; "
+                   "x = 6; x = 7; x = 8; x = 9; x = 10; }";
+
+  ASTnode *actual_ast = build_ast_for_quad_test(test_src);
+
+  Quad *actual_code_list = NULL;
+  make_TAC(actual_ast, &actual_code_list);
+  actual_code_list = reverse_tac_list(actual_code_list);
+
+  char *actual_output_string =
+      mips_list_to_string(generate_mips(actual_code_list));
+
+  assert(strstr(actual_output_string, "    li $t0, 10\n") != NULL);
+  assert(strstr(actual_output_string, "$t1") == NULL);
+  assert(strstr(actual_output_string, "$t8") == NULL);
+
+  free(actual_output_string);
+}
+
+void test_mips_call_in_condition() {
+  // The call is lowered before a is loaded, so a must not be loaded into the
+  // register that holds the call's result
+  char *test_src1 = "int id(int x) { return x; }";
+  char *test_src2 =
+      "int m(int a, int b) { if (a < id(b)) return 1; return 0; }";
+
+  ASTnode *actual_ast = build_ast_for_quad_test(test_src1);
+
+  Quad *actual_code_list = NULL;
+  make_TAC(actual_ast, &actual_code_list);
+
+  ASTnode *actual_ast_2 = continue_ast(test_src2);
+  make_TAC(actual_ast_2, &actual_code_list);
+
+  actual_code_list = reverse_tac_list(actual_code_list);
+
+  MipsInstruction *mips_list = NULL;
+  mips_list = generate_mips(actual_code_list);
+
+  char *actual_output_string = NULL;
+  actual_output_string = mips_list_to_string(mips_list);
+
+  char *expected_output_string = ".text\n"
+                                 "_id:\n"
+                                 "    la $sp, -8($sp)\n"
+                                 "    sw $fp, 4($sp)\n"
+                                 "    sw $ra, 0($sp)\n"
+                                 "    la $fp, 0($sp)\n"
+
+                                 "    lw $v0, 8($fp)\n"
+                                 "    j _L0\n"
+                                 "_L0:\n"
+
+                                 "    la $sp, 0($fp)\n"
+                                 "    lw $ra, 0($sp)\n"
+                                 "    lw $fp, 4($sp)\n"
+                                 "    la $sp, 8($sp)\n"
+                                 "    jr $ra\n"
+
+                                 "_m:\n"
+                                 "    la $sp, -8($sp)\n"
+                                 "    sw $fp, 4($sp)\n"
+                                 "    sw $ra, 0($sp)\n"
+                                 "    la $fp, 0($sp)\n"
+
+                                 "    lw $t8, 12($fp)\n"
+                                 "    la $sp, -4($sp)\n"
+                                 "    sw $t8, 0($sp)\n"
+                                 "    jal _id\n"
+                                 "    la $sp, 4($sp)\n"
+                                 "    move $t0, $v0\n"
+
+                                 "    lw $t8, 8($fp)\n"
+                                 "    bge $t8, $t0, _L2\n"
+
+                                 "_L1:\n"
+                                 "    li $t0, 1\n"
+                                 "    move $v0, $t0\n"
+                                 "    j _L3\n"
+
+                                 "_L2:\n"
+                                 "    li $t0, 0\n"
+                                 "    move $v0, $t0\n"
+                                 "    j _L3\n"
+
+                                 "_L3:\n"
+                                 "    la $sp, 0($fp)\n"
+                                 "    lw $ra, 0($sp)\n"
+                                 "    lw $fp, 4($sp)\n"
+                                 "    la $sp, 8($sp)\n"
+                                 "    jr $ra\n";
+
+  assert(strcmp(expected_output_string, actual_output_string) == 0);
+
+  free(actual_output_string);
+}
+
 void test_mips_return_statement() {
 
   char *test_src1 = "int f() { return 5; }";
@@ -891,12 +1540,32 @@ int main(void) {
   test_quad_println_with_integer();
   test_quad_println_chained_function_calls();
   test_quad_global_variable();
+  test_quad_temps_per_function();
+  test_quad_fold_constant_branches();
+  test_quad_constant_branch_needs_fold();
+  test_ast_hash_consing();
+  test_ast_file_round_trip();
+  test_sym_file_import();
+  test_ast_dump_formats();
+  test_ast_stats_shape();
+  test_inline_small_call();
+  test_pure_eval_constant_call();
+  test_symbol_table_scopes();
+  test_symbol_index();
+  test_symbol_registry_threads();
+  test_parser_formal_references();
+  test_parser_call_arity();
+  test_interp_run();
+  test_interp_matches_codegen_order();
   test_mips_func_defn();
   test_mips_println();
   test_mips_global_variables();
   test_mips_assign_global_variable();
+  test_mips_global_named_like_temp();
   test_mips_multiple_variables_and_println();
   test_mips_function_call_println();
   test_mips_if_stmt();
   test_mips_while_statement();
+  test_mips_temps_share_registers();
+  test_mips_call_in_condition();
 }